@@ -0,0 +1,546 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "actuator.h"
+
+#ifndef MIN
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#endif
+#ifndef MAX
+#define MAX(a,b) (((a)>(b))?(a):(b))
+#endif
+
+int sleep_until_signal(const struct timespec *t)
+{
+#ifdef __APPLE__
+	//no clock_nanosleep(), sleep for the remaining relative time
+	struct timespec now, remaining;
+	get_monotonic_time(&now);
+	long us = timespec_diff_us(t, &now);
+	if (us <= 0) return 0;
+	remaining.tv_sec = us / 1000000;
+	remaining.tv_nsec = (us % 1000000) * 1000;
+	return nanosleep(&remaining, NULL) != 0 && errno == EINTR ? -1 : 0;
+#else
+	return clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, t, NULL) == EINTR ? -1 : 0;
+#endif
+}
+
+void sleep_until(const struct timespec *t)
+{
+	while (sleep_until_signal(t) != 0);
+}
+
+//histogram bucket of a lateness
+static int lateness_bucket(long lateness)
+{
+	int i = 0;
+	while (i < LATENESS_BUCKETS - 1 && lateness >= (1L << i)) i++;
+	return i;
+}
+
+//1 if the process is stopped, 0 if not, -1 if its state can't be read
+static int is_stopped(pid_t pid)
+{
+#ifdef __linux__
+	char path[64], buffer[512];
+	sprintf(path, "/proc/%d/stat", pid);
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return -1;
+	ssize_t n = read(fd, buffer, sizeof(buffer) - 1);
+	close(fd);
+	if (n <= 0) return -1;
+	buffer[n] = '\0';
+	//the state follows the command, which may contain spaces
+	char *p = strrchr(buffer, ')');
+	if (p == NULL || p[1] == '\0' || p[2] == '\0') return -1;
+	return p[2] == 'T' || p[2] == 't';
+#else
+	return -1;
+#endif
+}
+
+//1 if the member is stopped, or all the cgroup is frozen with a freezer
+static int check_stopped(struct actuator *a, pid_t pid)
+{
+	return a->freezer != NULL ? is_cgroup_frozen(a->freezer) : is_stopped(pid);
+}
+
+//account the stop latency of a member, and the part of it seen for sure
+//missed means that it was still running when it was sent SIGCONT
+static void record_stop(struct actuator *a, pid_t pid, long latency, long seen, int missed)
+{
+	int bucket = lateness_bucket(latency);
+	pthread_mutex_lock(&a->lock);
+	a->stops++;
+	a->stop_latency_sum += latency;
+	if (latency > a->stop_latency_max) a->stop_latency_max = latency;
+	a->stop_histogram[bucket]++;
+	a->stop_histogram_total[bucket]++;
+	if (missed) a->stops_missed++;
+	//a member that doesn't stop at all (in D state, or a zombie) is no
+	//measure of how early it must be stopped
+	if (!missed && a->stop_results_count < MAX_STOP_RESULTS) {
+		a->stop_results[a->stop_results_count].pid = pid;
+		a->stop_results[a->stop_results_count].latency = seen;
+		a->stop_results_count++;
+	}
+	pthread_mutex_unlock(&a->lock);
+}
+
+static void remove_check(struct actuator *a, int i)
+{
+	a->checks[i] = a->checks[--a->checks_count];
+}
+
+//look for the members being verified that have stopped
+static void poll_stop_checks(struct actuator *a)
+{
+	struct timespec now;
+	int i = 0;
+	while (i < a->checks_count) {
+		get_monotonic_time(&now);
+		int stopped = check_stopped(a, a->checks[i].pid);
+		if (stopped == 0) {
+			a->checks[i].polled = now;
+			i++;
+			continue;
+		}
+		if (stopped > 0) {
+			//it stopped between the previous poll and this one
+			record_stop(a, a->checks[i].pid, timespec_diff_us(&now, &a->checks[i].sent), timespec_diff_us(&a->checks[i].polled, &a->checks[i].sent), 0);
+		}
+		remove_check(a, i);
+	}
+}
+
+//a member being verified is about to be sent SIGCONT: if it is not stopped
+//yet, it has kept running for the whole time
+//a thaw ends the check of the cgroup, whatever member it was made for
+static void cancel_stop_check(struct actuator *a, pid_t pid, const struct timespec *now)
+{
+	int i;
+	for (i=0; i<a->checks_count; i++) {
+		if (a->checks[i].pid != pid && a->freezer == NULL) continue;
+		int stopped = check_stopped(a, a->checks[i].pid);
+		if (stopped >= 0) record_stop(a, a->checks[i].pid, timespec_diff_us(now, &a->checks[i].sent), timespec_diff_us(&a->checks[i].polled, &a->checks[i].sent), !stopped);
+		remove_check(a, i);
+		return;
+	}
+}
+
+//sleep until the deadline, polling the members being verified meanwhile
+//most of them stop as soon as they get a cpu, the polls are frequent at
+//first and then back off
+static void wait_until(struct actuator *a, const struct timespec *deadline)
+{
+	struct timespec next;
+	long interval = STOP_CHECK_FIRST;
+	while (a->checks_count > 0) {
+		poll_stop_checks(a);
+		get_monotonic_time(&next);
+		timespec_add_us(&next, interval);
+		if (timespec_diff_us(&next, deadline) >= 0) break;
+		sleep_until(&next);
+		interval = MIN(interval * 2, STOP_CHECK_INTERVAL);
+	}
+	sleep_until(deadline);
+}
+
+//send the signals of a part of the edges due at the same time
+static void send_edges(struct actuator *a, struct fanout_part *part, const struct timespec *deadline)
+{
+	struct timespec now;
+	int i;
+	part->sum = 0;
+	part->max = 0;
+	part->failed = 0;
+	part->stops = 0;
+	memset(part->histogram, 0, sizeof(part->histogram));
+	for (i=0; i<part->count; i++) {
+		const struct slot_edge *edge = &part->edges[i];
+		get_monotonic_time(&now);
+		long lateness = timespec_diff_us(&now, deadline);
+		part->sum += lateness;
+		if (lateness > part->max) part->max = lateness;
+		part->histogram[lateness_bucket(lateness)]++;
+		if (edge->sig == SIGSTOP) {
+			if (part->stops++ == 0) part->first_stop = now;
+			part->last_stop = now;
+		}
+		if (a->freezer != NULL) {
+			if (freeze_cgroup(a->freezer, edge->sig == SIGSTOP) != 0) {
+				if (a->verbose) fprintf(stderr, "%s the cgroup failed\n", edge->sig == SIGSTOP ? "Freezing" : "Thawing");
+				part->failed = 1;
+			}
+		}
+		else if (kill(edge->pgid != 0 ? -edge->pgid : edge->proc->pid, edge->sig) != 0) {
+			if (a->verbose) fprintf(stderr, "%s failed. Process %d dead!\n", edge->sig == SIGSTOP ? "SIGSTOP" : "SIGCONT", edge->proc->pid);
+			part->failed = 1;
+		}
+	}
+}
+
+static void unlock_fanout(void *arg)
+{
+	struct actuator *a = (struct actuator*)arg;
+	pthread_mutex_unlock(&a->fanout_lock);
+}
+
+//a worker sends its part of every large batch, together with the actuator
+static void *fanout_worker(void *arg)
+{
+	struct fanout_part *part = (struct fanout_part*)arg;
+	struct actuator *a = part->actuator;
+	long generation = 0;
+	while (1) {
+		pthread_mutex_lock(&a->fanout_lock);
+		pthread_cleanup_push(unlock_fanout, a);
+		while (a->fanout_generation == generation) pthread_cond_wait(&a->fanout_start, &a->fanout_lock);
+		generation = a->fanout_generation;
+		pthread_cleanup_pop(1);
+		send_edges(a, part, &a->fanout_deadline);
+		pthread_mutex_lock(&a->fanout_lock);
+		if (--a->fanout_pending == 0) pthread_cond_signal(&a->fanout_done);
+		pthread_mutex_unlock(&a->fanout_lock);
+	}
+	return NULL;
+}
+
+//send the edges due at the same time, splitting them among the workers
+//when there are many
+//return the number of parts they were split into
+static int send_batch(struct actuator *a, const struct slot_edge *edges, int count, const struct timespec *deadline)
+{
+	int parts = 1, i;
+	if (count >= FANOUT_MIN_EDGES) parts += a->workers_count;
+	for (i=0; i<parts; i++) {
+		a->parts[i].edges = edges + (long)count * i / parts;
+		a->parts[i].count = (long)count * (i + 1) / parts - (long)count * i / parts;
+	}
+	if (parts > 1) {
+		pthread_mutex_lock(&a->fanout_lock);
+		a->fanout_deadline = *deadline;
+		a->fanout_pending = parts - 1;
+		a->fanout_generation++;
+		pthread_cond_broadcast(&a->fanout_start);
+		pthread_mutex_unlock(&a->fanout_lock);
+	}
+	send_edges(a, &a->parts[0], deadline);
+	if (parts > 1) {
+		pthread_mutex_lock(&a->fanout_lock);
+		pthread_cleanup_push(unlock_fanout, a);
+		while (a->fanout_pending > 0) pthread_cond_wait(&a->fanout_done, &a->fanout_lock);
+		pthread_cleanup_pop(1);
+	}
+	return parts;
+}
+
+//send the signals of the plan, at their time from the beginning of the slot
+//edges falling after the end of the slot are sent at the end
+static void run_plan(struct actuator *a, const struct slot_plan *plan, const struct timespec *start, const struct timespec *end)
+{
+	struct timespec deadline, now, first_stop, last_stop;
+	long edges = 0, sum = 0, max = 0;
+	long skews = 0, skew_sum = 0, skew_max = 0;
+	long histogram[LATENESS_BUCKETS];
+	int failed = 0;
+	int i, j, k, p;
+	//with many members, only one SIGSTOP every stride is verified, starting
+	//from a different one at every slot
+	//plans keeping all the members stopped are not verified, the members
+	//are stopped already
+	int stops = 0, conts = 0, stride, phase;
+	for (i=0; i<plan->count; i++) {
+		if (plan->edges[i].sig == SIGSTOP) stops++;
+		else conts++;
+	}
+	stride = (stops + MAX_STOP_CHECKS - 1) / MAX_STOP_CHECKS;
+	if (stride < 1) stride = 1;
+	phase = conts > 0 ? a->checks_rotation++ % stride : -1;
+	stops = 0;
+	memset(histogram, 0, sizeof(histogram));
+	for (i=0; i<plan->count; i=j) {
+		//the edges due at the same time are sent in a batch
+		for (j=i+1; j<plan->count && plan->edges[j].offset == plan->edges[i].offset; j++);
+		deadline = *start;
+		timespec_add_us(&deadline, plan->edges[i].offset);
+		if (timespec_diff_us(&deadline, end) > 0) deadline = *end;
+		wait_until(a, &deadline);
+		if (a->checks_count > 0) {
+			get_monotonic_time(&now);
+			for (k=i; k<j; k++) {
+				if (plan->edges[k].sig == SIGCONT) cancel_stop_check(a, plan->edges[k].proc->pid, &now);
+			}
+		}
+		int parts = send_batch(a, &plan->edges[i], j - i, &deadline);
+		get_monotonic_time(&now);
+		//accounting, and the time from the first to the last SIGSTOP
+		int batch_stops = 0;
+		for (p=0; p<parts; p++) {
+			struct fanout_part *part = &a->parts[p];
+			edges += part->count;
+			sum += part->sum;
+			if (part->max > max) max = part->max;
+			for (k=0; k<LATENESS_BUCKETS; k++) histogram[k] += part->histogram[k];
+			if (part->failed) failed = 1;
+			if (part->stops == 0) continue;
+			if (batch_stops == 0 || timespec_diff_us(&part->first_stop, &first_stop) < 0) first_stop = part->first_stop;
+			if (batch_stops == 0 || timespec_diff_us(&part->last_stop, &last_stop) > 0) last_stop = part->last_stop;
+			batch_stops += part->stops;
+		}
+		if (batch_stops > 0) {
+			long skew = timespec_diff_us(&last_stop, &first_stop);
+			skews++;
+			skew_sum += skew;
+			if (skew > skew_max) skew_max = skew;
+		}
+		//verify some of the stops, from the end of the batch
+		for (k=i; k<j; k++) {
+			if (plan->edges[k].sig != SIGSTOP || stops++ % stride != phase || a->checks_count >= MAX_STOP_CHECKS) continue;
+			a->checks[a->checks_count].pid = plan->edges[k].proc->pid;
+			a->checks[a->checks_count].sent = now;
+			a->checks[a->checks_count].polled = now;
+			a->checks_count++;
+		}
+	}
+	pthread_mutex_lock(&a->lock);
+	if (failed) a->failed = 1;
+	a->edges += edges;
+	a->lateness_sum += sum;
+	if (max > a->lateness_max) a->lateness_max = max;
+	for (i=0; i<LATENESS_BUCKETS; i++) a->lateness_histogram[i] += histogram[i];
+	a->skews += skews;
+	a->skew_sum += skew_sum;
+	if (skew_max > a->skew_max) a->skew_max = skew_max;
+	pthread_mutex_unlock(&a->lock);
+}
+
+static void unlock_actuator(void *arg)
+{
+	struct actuator *a = (struct actuator*)arg;
+	pthread_mutex_unlock(&a->lock);
+}
+
+static void *actuator_thread(void *arg)
+{
+	struct actuator *a = (struct actuator*)arg;
+	struct timespec start, end, now;
+	get_monotonic_time(&start);
+	while (1) {
+		pthread_mutex_lock(&a->lock);
+		pthread_cleanup_push(unlock_actuator, a);
+		if (!a->fresh && a->current->count == 0) {
+			//nothing to send: wait for a new plan, and start the slot then
+			//the members are left stopped or running as they are
+			a->checks_count = 0;
+			while (!a->fresh) pthread_cond_wait(&a->cond, &a->lock);
+			get_monotonic_time(&start);
+		}
+		if (a->fresh) {
+			struct slot_plan *tmp = a->current;
+			a->current = a->ready;
+			a->ready = tmp;
+			a->fresh = 0;
+		}
+		pthread_cleanup_pop(1);
+		end = start;
+		timespec_add_us(&end, a->current->length);
+		run_plan(a, a->current, &start, &end);
+		wait_until(a, &end);
+		get_monotonic_time(&now);
+		//if the slot has been overrun, restart the schedule from now
+		start = timespec_diff_us(&now, &end) > 0 ? now : end;
+	}
+	return NULL;
+}
+
+int start_actuator(struct actuator *a, long length, struct cpu_cgroup *freezer, int verbose)
+{
+	int i;
+	sigset_t all, old;
+	for (i=0; i<3; i++) init_slot_plan(&a->plans[i], length);
+	a->back = &a->plans[0];
+	a->ready = &a->plans[1];
+	a->current = &a->plans[2];
+	a->fresh = 0;
+	a->freezer = freezer;
+	a->verbose = verbose;
+	a->failed = 0;
+	a->edges = 0;
+	a->lateness_sum = 0;
+	a->lateness_max = 0;
+	memset(a->lateness_histogram, 0, sizeof(a->lateness_histogram));
+	a->checks_count = 0;
+	a->checks_rotation = 0;
+	a->stop_results_count = 0;
+	a->stops = 0;
+	a->stop_latency_sum = 0;
+	a->stop_latency_max = 0;
+	memset(a->stop_histogram, 0, sizeof(a->stop_histogram));
+	memset(a->stop_histogram_total, 0, sizeof(a->stop_histogram_total));
+	a->stops_missed = 0;
+	a->skews = 0;
+	a->skew_sum = 0;
+	a->skew_max = 0;
+	pthread_mutex_init(&a->lock, NULL);
+	pthread_cond_init(&a->cond, NULL);
+	pthread_mutex_init(&a->fanout_lock, NULL);
+	pthread_cond_init(&a->fanout_start, NULL);
+	pthread_cond_init(&a->fanout_done, NULL);
+	a->fanout_generation = 0;
+	a->fanout_pending = 0;
+	//one worker for every other cpu, they would only queue up on the same one
+	int workers = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+	workers = MAX(MIN(workers, MAX_FANOUT_WORKERS), 0);
+	//the signals sent to cpulimit are handled by the sampler
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	a->running = pthread_create(&a->thread, NULL, actuator_thread, a) == 0;
+	for (a->workers_count=0; a->running && a->workers_count<workers; a->workers_count++) {
+		a->parts[a->workers_count + 1].actuator = a;
+		if (pthread_create(&a->workers[a->workers_count], NULL, fanout_worker, &a->parts[a->workers_count + 1]) != 0) break;
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	return a->running ? 0 : -1;
+}
+
+void publish_plan(struct actuator *a)
+{
+	pthread_mutex_lock(&a->lock);
+	struct slot_plan *tmp = a->ready;
+	a->ready = a->back;
+	a->back = tmp;
+	a->fresh = 1;
+	pthread_cond_signal(&a->cond);
+	pthread_mutex_unlock(&a->lock);
+}
+
+//99th percentile of a histogram of count values, at most max
+static long get_p99(const long histogram[LATENESS_BUCKETS], long count, long max)
+{
+	long sum = 0;
+	int i;
+	for (i=0; i<LATENESS_BUCKETS && count > 0; i++) {
+		sum += histogram[i];
+		if (sum >= count * 0.99) return MIN(1L << i, max);
+	}
+	return 0;
+}
+
+long get_edge_stats(struct actuator *a, double *mean, long *p99, long *max)
+{
+	pthread_mutex_lock(&a->lock);
+	long edges = a->edges;
+	*mean = edges > 0 ? a->lateness_sum / edges : 0;
+	*max = a->lateness_max;
+	*p99 = get_p99(a->lateness_histogram, edges, *max);
+	a->edges = 0;
+	a->lateness_sum = 0;
+	a->lateness_max = 0;
+	memset(a->lateness_histogram, 0, sizeof(a->lateness_histogram));
+	pthread_mutex_unlock(&a->lock);
+	return edges;
+}
+
+long get_stop_stats(struct actuator *a, double *mean, long *p99, long *max)
+{
+	pthread_mutex_lock(&a->lock);
+	long stops = a->stops;
+	*mean = stops > 0 ? a->stop_latency_sum / stops : 0;
+	*max = a->stop_latency_max;
+	*p99 = get_p99(a->stop_histogram, stops, *max);
+	a->stops = 0;
+	a->stop_latency_sum = 0;
+	a->stop_latency_max = 0;
+	memset(a->stop_histogram, 0, sizeof(a->stop_histogram));
+	pthread_mutex_unlock(&a->lock);
+	return stops;
+}
+
+long get_skew_stats(struct actuator *a, double *mean, long *max)
+{
+	pthread_mutex_lock(&a->lock);
+	long skews = a->skews;
+	*mean = skews > 0 ? a->skew_sum / skews : 0;
+	*max = a->skew_max;
+	a->skews = 0;
+	a->skew_sum = 0;
+	a->skew_max = 0;
+	pthread_mutex_unlock(&a->lock);
+	return skews;
+}
+
+long get_stop_histogram(struct actuator *a, long histogram[LATENESS_BUCKETS])
+{
+	pthread_mutex_lock(&a->lock);
+	memcpy(histogram, a->stop_histogram_total, sizeof(a->stop_histogram_total));
+	long missed = a->stops_missed;
+	pthread_mutex_unlock(&a->lock);
+	return missed;
+}
+
+int get_stop_latencies(struct actuator *a, struct stop_result *results, int max)
+{
+	pthread_mutex_lock(&a->lock);
+	int count = MIN(a->stop_results_count, max);
+	memcpy(results, a->stop_results, count * sizeof(struct stop_result));
+	a->stop_results_count = 0;
+	pthread_mutex_unlock(&a->lock);
+	return count;
+}
+
+int get_failed_signals(struct actuator *a)
+{
+	pthread_mutex_lock(&a->lock);
+	int failed = a->failed;
+	a->failed = 0;
+	pthread_mutex_unlock(&a->lock);
+	return failed;
+}
+
+void stop_actuator(struct actuator *a)
+{
+	int i;
+	if (!a->running) return;
+	a->running = 0;
+	pthread_cancel(a->thread);
+	pthread_join(a->thread, NULL);
+	for (i=0; i<a->workers_count; i++) {
+		pthread_cancel(a->workers[i]);
+		pthread_join(a->workers[i], NULL);
+	}
+	for (i=0; i<3; i++) close_slot_plan(&a->plans[i]);
+	pthread_mutex_destroy(&a->lock);
+	pthread_cond_destroy(&a->cond);
+	pthread_mutex_destroy(&a->fanout_lock);
+	pthread_cond_destroy(&a->fanout_start);
+	pthread_cond_destroy(&a->fanout_done);
+}
@@ -0,0 +1,252 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef __ACTUATOR_H
+
+#define __ACTUATOR_H
+
+#include <time.h>
+#include <pthread.h>
+
+#include "slot.h"
+#include "cgroup.h"
+
+//buckets of the lateness histogram: bucket i counts the edges late by
+//less than 2^i microseconds, the last one all the others
+#define LATENESS_BUCKETS 22
+
+//members whose stop is verified at the same time, first and longest
+//interval at which their state is polled (in microseconds), and stop
+//latencies kept until the sampler collects them
+#define MAX_STOP_CHECKS 16
+#define STOP_CHECK_FIRST 10
+#define STOP_CHECK_INTERVAL 200
+#define MAX_STOP_RESULTS 256
+
+//worker threads sending the signals of large batches, and the smallest
+//batch split among them
+#define MAX_FANOUT_WORKERS 4
+#define FANOUT_MIN_EDGES 64
+
+struct actuator;
+
+// the part of a batch of edges sent by one thread, and its timing
+struct fanout_part {
+	struct actuator *actuator;
+	const struct slot_edge *edges;
+	int count;
+	//total and maximum lateness (in microseconds), and its histogram
+	long sum;
+	long max;
+	long histogram[LATENESS_BUCKETS];
+	//1 if a signal has failed
+	int failed;
+	//SIGSTOP edges, and when the first and the last of them were sent
+	int stops;
+	struct timespec first_stop;
+	struct timespec last_stop;
+};
+
+// a member that has been sent SIGSTOP, and not yet seen stopped
+struct stop_check {
+	pid_t pid;
+	struct timespec sent;
+	//last poll that found it still running
+	struct timespec polled;
+};
+
+// the stop latency measured for a member (in microseconds), only the part
+// of it seen for sure: up to the last poll finding it still running
+// the members that didn't stop before SIGCONT are not reported
+struct stop_result {
+	pid_t pid;
+	long latency;
+};
+
+// a thread sending the signals of the slot plans, at their exact time
+// the plans are computed by the sampler (the thread scanning the processes)
+// and handed over through a triple buffer, so that neither side waits for
+// the other: the sampler fills back, publishes it as ready, and the
+// actuator takes ready as current at the beginning of a slot
+struct actuator {
+	pthread_t thread;
+	//1 if the thread is running
+	int running;
+	pthread_mutex_t lock;
+	//signalled when a plan is published
+	pthread_cond_t cond;
+	struct slot_plan plans[3];
+	//plan being filled by the sampler
+	struct slot_plan *back;
+	//last plan published
+	struct slot_plan *ready;
+	//plan being run by the actuator
+	struct slot_plan *current;
+	//1 if ready has not been taken yet
+	int fresh;
+	//cgroup frozen and thawed in place of the signals, NULL to send them
+	//the plans have a single window then, for the whole cgroup
+	struct cpu_cgroup *freezer;
+	//log failed signals
+	int verbose;
+	//1 if a signal has failed since the last call to get_failed_signals()
+	int failed;
+	//edges sent since the last call to get_edge_stats(), and their total
+	//and maximum lateness (in microseconds)
+	long edges;
+	double lateness_sum;
+	long lateness_max;
+	long lateness_histogram[LATENESS_BUCKETS];
+	//stops being verified, only used by the actuator thread
+	//a few SIGSTOP edges per slot are verified, rotating among the members
+	struct stop_check checks[MAX_STOP_CHECKS];
+	int checks_count;
+	long checks_rotation;
+	//stop latencies not collected yet by get_stop_latencies()
+	struct stop_result stop_results[MAX_STOP_RESULTS];
+	int stop_results_count;
+	//stops verified since the last call to get_stop_stats(), and their total
+	//and maximum latency (in microseconds)
+	long stops;
+	double stop_latency_sum;
+	long stop_latency_max;
+	long stop_histogram[LATENESS_BUCKETS];
+	//histogram of all the stops verified, and how many of them were still
+	//running when they were sent SIGCONT again
+	long stop_histogram_total[LATENESS_BUCKETS];
+	long stops_missed;
+	//the edges due at the same time are sent in a batch, split among the
+	//actuator (part 0) and the workers when it is large
+	pthread_t workers[MAX_FANOUT_WORKERS];
+	int workers_count;
+	struct fanout_part parts[MAX_FANOUT_WORKERS + 1];
+	pthread_mutex_t fanout_lock;
+	//signalled when a batch is handed to the workers, and when they are done
+	pthread_cond_t fanout_start;
+	pthread_cond_t fanout_done;
+	//incremented for every batch, and workers still sending it
+	long fanout_generation;
+	int fanout_pending;
+	struct timespec fanout_deadline;
+	//batches with SIGSTOP edges sent since the last call to get_skew_stats(),
+	//and the total and maximum time from their first to their last SIGSTOP
+	//(in microseconds)
+	long skews;
+	double skew_sum;
+	long skew_max;
+};
+
+//return t1-t2 in microseconds (no overflow checks, so better watch out!)
+static inline long timespec_diff_us(const struct timespec *t1, const struct timespec *t2)
+{
+	return (t1->tv_sec - t2->tv_sec) * 1000000 + (t1->tv_nsec - t2->tv_nsec) / 1000;
+}
+
+//add us microseconds to t
+static inline void timespec_add_us(struct timespec *t, long us)
+{
+	t->tv_sec += us / 1000000;
+	t->tv_nsec += (us % 1000000) * 1000;
+	if (t->tv_nsec >= 1000000000) {
+		t->tv_sec++;
+		t->tv_nsec -= 1000000000;
+	}
+}
+
+static inline void get_monotonic_time(struct timespec *t)
+{
+	clock_gettime(CLOCK_MONOTONIC, t);
+}
+
+/*
+ * Sleep until the absolute monotonic time t, return immediately if it's
+ * already past
+ */
+void sleep_until(const struct timespec *t);
+
+/*
+ * Like sleep_until(), but return early when a signal is handled
+ * return 0 when the time has come, -1 if interrupted
+ */
+int sleep_until_signal(const struct timespec *t);
+
+/*
+ * Start the actuator thread, with slots of the given length
+ * with a freezer, SIGSTOP and SIGCONT edges freeze and thaw it instead
+ * the thread doesn't handle any signal sent to cpulimit
+ * return 0 on success, -1 on error
+ */
+int start_actuator(struct actuator *a, long length, struct cpu_cgroup *freezer, int verbose);
+
+/*
+ * Hand the back plan over to the actuator, which runs it from the
+ * beginning of the next slot
+ * a plan without edges makes the actuator wait for the next one
+ */
+void publish_plan(struct actuator *a);
+
+/*
+ * Get the mean, 99th percentile and maximum lateness of the edges sent
+ * since the last call (in microseconds), and return their number
+ * the percentile is the upper bound of its histogram bucket
+ */
+long get_edge_stats(struct actuator *a, double *mean, long *p99, long *max);
+
+/*
+ * Get the mean, 99th percentile and maximum stop latency of the members
+ * verified since the last call (in microseconds), and return their number
+ * the latency is the time from SIGSTOP to the first poll that finds the
+ * member stopped, or to its next SIGCONT if it never stops
+ */
+long get_stop_stats(struct actuator *a, double *mean, long *p99, long *max);
+
+/*
+ * Get the mean and maximum time from the first to the last SIGSTOP sent at
+ * the same time (in microseconds) since the last call, and return the
+ * number of such batches
+ */
+long get_skew_stats(struct actuator *a, double *mean, long *max);
+
+/*
+ * Copy the histogram of all the stop latencies measured so far, bucketed as
+ * the lateness, and return the number of stops that never took effect
+ */
+long get_stop_histogram(struct actuator *a, long histogram[LATENESS_BUCKETS]);
+
+/*
+ * Move up to max stop latencies measured since the last call into results,
+ * and return their number
+ */
+int get_stop_latencies(struct actuator *a, struct stop_result *results, int max);
+
+/*
+ * Return 1 if some signal has failed since the last call, meaning that
+ * some member is dead
+ */
+int get_failed_signals(struct actuator *a);
+
+/*
+ * Stop the actuator thread immediately, even in the middle of a slot
+ */
+void stop_actuator(struct actuator *a);
+
+#endif
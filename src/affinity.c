@@ -0,0 +1,135 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include "affinity.h"
+
+#ifdef __linux__
+
+int init_affinity(struct affinity *a, pid_t pid, int offset)
+{
+	cpu_set_t own;
+	//a target pinned to some cpus stays on them
+	if (sched_getaffinity(pid, sizeof(cpu_set_t), &a->allowed) != 0) return -1;
+	if (sched_getaffinity(0, sizeof(cpu_set_t), &own) == 0) {
+		CPU_AND(&own, &own, &a->allowed);
+		if (CPU_COUNT(&own) > 0) a->allowed = own;
+	}
+	a->allowed_count = CPU_COUNT(&a->allowed);
+	a->offset = a->allowed_count > 0 ? offset % a->allowed_count : 0;
+	a->mask = a->allowed;
+	a->count = a->allowed_count;
+	a->version = 1;
+	return 0;
+}
+
+int resize_affinity(struct affinity *a, int count)
+{
+	int cpu, i;
+	if (count < 1) count = 1;
+	if (count > a->allowed_count) count = a->allowed_count;
+	if (count == a->count) return 0;
+	//take count allowed cpus, starting from the offset-th and wrapping around
+	CPU_ZERO(&a->mask);
+	a->count = 0;
+	for (i=0, cpu=0; cpu<CPU_SETSIZE && a->count<count; cpu++) {
+		if (!CPU_ISSET(cpu, &a->allowed)) continue;
+		if (i++ >= a->offset) {
+			CPU_SET(cpu, &a->mask);
+			a->count++;
+		}
+	}
+	for (cpu=0; cpu<CPU_SETSIZE && a->count<count; cpu++) {
+		if (CPU_ISSET(cpu, &a->allowed) && !CPU_ISSET(cpu, &a->mask)) {
+			CPU_SET(cpu, &a->mask);
+			a->count++;
+		}
+	}
+	a->version++;
+	return 1;
+}
+
+//set the mask of every thread of the process
+static int set_threads_affinity(pid_t pid, cpu_set_t *mask)
+{
+	char path[64];
+	struct dirent *dit;
+	int ret = 0;
+	sprintf(path, "/proc/%d/task", pid);
+	DIR *dip = opendir(path);
+	if (dip == NULL) return -1;
+	while ((dit = readdir(dip)) != NULL) {
+		if (dit->d_name[0] == '.') continue;
+		if (sched_setaffinity(atoi(dit->d_name), sizeof(cpu_set_t), mask) != 0) ret = -1;
+	}
+	closedir(dip);
+	return ret;
+}
+
+//the mask is kept in the process as plain bytes
+typedef char cpu_mask_size_check[sizeof(cpu_set_t) == CPU_MASK_SIZE ? 1 : -1];
+
+int apply_affinity(struct affinity *a, struct process *p)
+{
+	cpu_set_t original;
+	if (p->mask_version == 0) {
+		if (sched_getaffinity(p->pid, sizeof(cpu_set_t), &original) != 0) CPU_ZERO(&original);
+		memcpy(p->original_mask, &original, sizeof(cpu_set_t));
+	}
+	return set_threads_affinity(p->pid, &a->mask);
+}
+
+int reset_affinity(struct affinity *a, struct process *p)
+{
+	cpu_set_t original;
+	if (p->mask_version == 0) return 0;
+	memcpy(&original, p->original_mask, sizeof(cpu_set_t));
+	if (CPU_COUNT(&original) == 0) return 0;
+	return set_threads_affinity(p->pid, &original);
+}
+
+#else
+
+int init_affinity(struct affinity *a, pid_t pid, int offset)
+{
+	return -1;
+}
+
+int resize_affinity(struct affinity *a, int count)
+{
+	return 0;
+}
+
+int apply_affinity(struct affinity *a, struct process *p)
+{
+	return -1;
+}
+
+int reset_affinity(struct affinity *a, struct process *p)
+{
+	return -1;
+}
+
+#endif
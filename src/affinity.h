@@ -0,0 +1,83 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __AFFINITY_H
+
+#define __AFFINITY_H
+
+#include <sys/types.h>
+
+#include "process_iterator.h"
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+// a cpu mask applied to all the threads of the limited processes
+struct affinity {
+#ifdef __linux__
+	//cpus that both the target process and cpulimit were allowed to use
+	//when it started
+	cpu_set_t allowed;
+	//mask applied to the processes
+	cpu_set_t mask;
+#endif
+	//number of cpus in allowed
+	int allowed_count;
+	//number of cpus in mask
+	int count;
+	//index of the first allowed cpu in the mask
+	int offset;
+	//incremented every time the mask changes
+	int version;
+};
+
+/*
+ * Initialize the mask from the cpus the target process is allowed to use,
+ * if cpulimit is allowed to use some of them, only those
+ * offset is used to pick the first cpu, so that different limiters use
+ * different cpus
+ * return 0 on success, -1 if affinity is not supported on this system or
+ * if the process does not exist
+ */
+int init_affinity(struct affinity *a, pid_t pid, int offset);
+
+/*
+ * Make the mask contain count cpus (at least 1, at most all the allowed ones)
+ * return 1 if the mask has changed, 0 otherwise
+ */
+int resize_affinity(struct affinity *a, int count);
+
+/*
+ * Apply the mask to all the threads of a process
+ * the first time, the mask of the process is saved in p
+ * return 0 on success, -1 on error
+ */
+int apply_affinity(struct affinity *a, struct process *p);
+
+/*
+ * Give all the threads of a process back the mask saved by
+ * apply_affinity(), if any
+ * return 0 on success, -1 on error
+ */
+int reset_affinity(struct affinity *a, struct process *p);
+
+#endif
@@ -0,0 +1,151 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/stat.h>
+#ifdef __APPLE__
+#include <sys/sysctl.h>
+#endif
+#ifdef HAVE_SYS_SYSINFO_H
+#include <sys/sysinfo.h>
+#endif
+
+#include "capacity.h"
+#include "cgroup.h"
+
+int get_online_cpus()
+{
+	int ncpu;
+#ifdef _SC_NPROCESSORS_ONLN
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+#elif defined __APPLE__
+	int mib[2] = {CTL_HW, HW_NCPU};
+	size_t len = sizeof(ncpu);
+	sysctl(mib, 2, &ncpu, &len, NULL, 0);
+#elif defined _GNU_SOURCE
+	ncpu = get_nprocs();
+#else
+	ncpu = -1;
+#endif
+	return ncpu;
+}
+
+int count_cpu_list(const char *list)
+{
+	const char *p = list;
+	char *end;
+	int count = 0;
+	while (*p != '\0' && *p != '\n') {
+		long first = strtol(p, &end, 10);
+		long last = first;
+		if (end == p || first < 0) return -1;
+		if (*end == '-') {
+			p = end + 1;
+			last = strtol(p, &end, 10);
+			if (end == p || last < first) return -1;
+		}
+		count += last - first + 1;
+		p = end;
+		if (*p == ',') p++;
+		else if (*p != '\0' && *p != '\n') return -1;
+	}
+	return count;
+}
+
+//read the first line of a file in a cgroup directory
+static int read_cgroup_file(const char *dir, const char *name, char *buffer, int size)
+{
+	char path[PATH_MAX+1];
+	if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= (int)sizeof(path)) return -1;
+	FILE *fd = fopen(path, "r");
+	if (fd == NULL) return -1;
+	char *line = fgets(buffer, size, fd);
+	fclose(fd);
+	return line == NULL ? -1 : 0;
+}
+
+double get_cgroup_quota(const char *root, const char *path, const char *exclude)
+{
+	char dir[PATH_MAX+1];
+	char buffer[64];
+	char *slash;
+	double quota = -1;
+	long max, period;
+	struct stat excluded, st;
+	//the same directory can be named in many ways
+	int exclude_ok = exclude != NULL && stat(exclude, &excluded) == 0;
+	if (snprintf(dir, sizeof(dir), "%s%s", root, path) >= (int)sizeof(dir)) return -1;
+	//the quota of every ancestor applies, but there is none at the root
+	while (strlen(dir) > strlen(root)) {
+		int skip = exclude_ok && stat(dir, &st) == 0 && st.st_dev == excluded.st_dev && st.st_ino == excluded.st_ino;
+		if (!skip && read_cgroup_file(dir, "cpu.max", buffer, sizeof(buffer)) == 0
+			&& sscanf(buffer, "%ld %ld", &max, &period) == 2 && period > 0) {
+			if (quota < 0 || (double)max / period < quota) quota = (double)max / period;
+		}
+		slash = strrchr(dir, '/');
+		if (slash == NULL) break;
+		*slash = '\0';
+	}
+	return quota;
+}
+
+int get_cgroup_cpuset(const char *root, const char *path)
+{
+	char dir[PATH_MAX+1];
+	char buffer[1024];
+	if (snprintf(dir, sizeof(dir), "%s%s", root, path) >= (int)sizeof(dir)) return -1;
+	//the effective cpuset already takes the ancestors into account
+	if (read_cgroup_file(dir, "cpuset.cpus.effective", buffer, sizeof(buffer)) != 0) return -1;
+	return count_cpu_list(buffer);
+}
+
+#ifdef __linux__
+double get_cpu_capacity(pid_t pid, const char *exclude)
+{
+	cpu_set_t mask;
+	char root[PATH_MAX+1], path[PATH_MAX+1];
+	double capacity = get_online_cpus();
+	if (capacity <= 0) return -1;
+	//the process may be gone
+	if (sched_getaffinity(pid, sizeof(cpu_set_t), &mask) != 0) return -1;
+	if (CPU_COUNT(&mask) < capacity) capacity = CPU_COUNT(&mask);
+	if (find_cgroup_root(root, sizeof(root)) == 0 && find_process_cgroup(pid, path, sizeof(path)) == 0) {
+		int cpuset = get_cgroup_cpuset(root, path);
+		if (cpuset > 0 && cpuset < capacity) capacity = cpuset;
+		double quota = get_cgroup_quota(root, path, exclude);
+		if (quota > 0 && quota < capacity) capacity = quota;
+	}
+	return capacity;
+}
+
+#else
+
+double get_cpu_capacity(pid_t pid, const char *exclude)
+{
+	return get_online_cpus();
+}
+
+#endif
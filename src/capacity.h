@@ -0,0 +1,65 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __CAPACITY_H
+
+#define __CAPACITY_H
+
+#include <sys/types.h>
+
+/*
+ * Number of online cpus of the host, or -1 if it can't be found
+ */
+int get_online_cpus();
+
+/*
+ * Count the cpus in a list such as 0-3,8,10-11 (as in cpuset.cpus)
+ * return -1 if the list is not valid
+ */
+int count_cpu_list(const char *list);
+
+/*
+ * Cpus allowed by the cpu.max quota of a cgroup v2 and of all its
+ * ancestors, the lowest of them
+ * root is the mount point of the hierarchy, path the cgroup in it
+ * the quota of the cgroup in the directory exclude (NULL means none) is
+ * left out, it is the one written by the limiter itself
+ * return -1 if there is no quota
+ */
+double get_cgroup_quota(const char *root, const char *path, const char *exclude);
+
+/*
+ * Number of cpus in the effective cpuset of a cgroup v2
+ * return -1 if the cpuset is not available
+ */
+int get_cgroup_cpuset(const char *root, const char *path);
+
+/*
+ * Cpus a process can actually use (pid 0 means the calling process): the
+ * online cpus, restricted by its affinity mask and by the cpuset and cpu
+ * quota of its cgroup
+ * exclude is a cgroup whose quota is left out (see get_cgroup_quota())
+ * return -1 if the process does not exist, or if not even the online cpus
+ * can be found
+ */
+double get_cpu_capacity(pid_t pid, const char *exclude);
+
+#endif
@@ -0,0 +1,299 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/stat.h>
+
+#include "cgroup.h"
+
+static int open_cgroup_file(const char *dir, const char *name, int flags)
+{
+	char path[PATH_MAX+1];
+	if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= (int)sizeof(path)) return -1;
+	return open(path, flags);
+}
+
+//write a value to a file of a cgroup, which must exist already
+static int write_cgroup_file(const char *dir, const char *name, const char *value)
+{
+	int fd = open_cgroup_file(dir, name, O_WRONLY | O_TRUNC);
+	if (fd < 0) return -1;
+	int ret = write(fd, value, strlen(value)) == (ssize_t)strlen(value) ? 0 : -1;
+	close(fd);
+	return ret;
+}
+
+int find_cgroup_root(char *root, int size)
+{
+	char line[PATH_MAX+64];
+	char dir[PATH_MAX+1], type[32];
+	int ret = -1;
+	FILE *fd = fopen("/proc/mounts", "r");
+	if (fd == NULL) return -1;
+	while (ret != 0 && fgets(line, sizeof(line), fd) != NULL) {
+		if (sscanf(line, "%*s %4096s %31s", dir, type) == 2 && strcmp(type, "cgroup2") == 0) {
+			snprintf(root, size, "%s", dir);
+			ret = 0;
+		}
+	}
+	fclose(fd);
+	return ret;
+}
+
+int find_process_cgroup(pid_t pid, char *path, int size)
+{
+	char file[32];
+	char line[PATH_MAX+8];
+	int ret = -1;
+	if (pid == 0) sprintf(file, "/proc/self/cgroup");
+	else sprintf(file, "/proc/%d/cgroup", pid);
+	FILE *fd = fopen(file, "r");
+	if (fd == NULL) return -1;
+	while (ret != 0 && fgets(line, sizeof(line), fd) != NULL) {
+		//the unified hierarchy has id 0 and no controllers
+		if (strncmp(line, "0::", 3) == 0) {
+			line[strcspn(line, "\n")] = '\0';
+			//the root cgroup is just "/"
+			snprintf(path, size, "%s", strcmp(line + 3, "/") == 0 ? "" : line + 3);
+			ret = 0;
+		}
+	}
+	fclose(fd);
+	return ret;
+}
+
+static int can_write_cgroup_file(const char *dir, const char *name)
+{
+	char path[PATH_MAX+1];
+	if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= (int)sizeof(path)) return 0;
+	return access(path, W_OK) == 0;
+}
+
+//create the cgroup, or reuse it if it exists
+static int make_cgroup(struct cpu_cgroup *cg, const char *path, long period)
+{
+	if (snprintf(cg->path, sizeof(cg->path), "%s", path) >= (int)sizeof(cg->path)) return -1;
+	cg->period = period;
+	//nothing written yet
+	cg->quota = 0;
+	cg->freeze_fd = -1;
+	cg->events_fd = -1;
+	cg->origins = NULL;
+	cg->origins_count = 0;
+	cg->moves = NULL;
+	cg->moves_count = 0;
+	//without it the processes can't be moved back
+	if (find_cgroup_root(cg->root, sizeof(cg->root)) != 0) cg->root[0] = '\0';
+	cg->created = mkdir(path, 0755) == 0;
+	return cg->created || errno == EEXIST ? 0 : -1;
+}
+
+int open_cgroup(struct cpu_cgroup *cg, const char *path, long period)
+{
+	char parent[PATH_MAX+1];
+	if (make_cgroup(cg, path, period) != 0) return -1;
+	if (!can_write_cgroup_file(cg->path, "cpu.max")) {
+		//the cpu controller is not enabled for the children of the parent
+		snprintf(parent, sizeof(parent), "%s", path);
+		write_cgroup_file(dirname(parent), "cgroup.subtree_control", "+cpu");
+		if (!can_write_cgroup_file(cg->path, "cpu.max")) {
+			if (cg->created) rmdir(cg->path);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int open_cgroup_freezer(struct cpu_cgroup *cg, const char *path)
+{
+	//no quota is ever written
+	if (make_cgroup(cg, path, 0) != 0) return -1;
+	//the freezer is written and polled at every slot, keep the files open
+	cg->freeze_fd = open_cgroup_file(cg->path, "cgroup.freeze", O_WRONLY);
+	cg->events_fd = open_cgroup_file(cg->path, "cgroup.events", O_RDONLY);
+	if (cg->freeze_fd < 0 || cg->events_fd < 0) {
+		if (cg->freeze_fd >= 0) close(cg->freeze_fd);
+		if (cg->events_fd >= 0) close(cg->events_fd);
+		cg->freeze_fd = cg->events_fd = -1;
+		if (cg->created) rmdir(cg->path);
+		return -1;
+	}
+	return 0;
+}
+
+//remember the cgroup of a process before moving it, the cgroups are
+//usually the same for all of them and are stored once
+static void save_origin(struct cpu_cgroup *cg, pid_t pid)
+{
+	char path[PATH_MAX+1];
+	int i;
+	if (cg->root[0] == '\0' || find_process_cgroup(pid, path, sizeof(path)) != 0) return;
+	for (i=0; i<cg->origins_count && strcmp(cg->origins[i], path) != 0; i++);
+	if (i == cg->origins_count) {
+		char **origins = realloc(cg->origins, (i + 1) * sizeof(char*));
+		if (origins == NULL) return;
+		cg->origins = origins;
+		if ((cg->origins[i] = strdup(path)) == NULL) return;
+		cg->origins_count++;
+	}
+	struct cgroup_move *moves = realloc(cg->moves, (cg->moves_count + 1) * sizeof(struct cgroup_move));
+	if (moves == NULL) return;
+	cg->moves = moves;
+	cg->moves[cg->moves_count].pid = pid;
+	cg->moves[cg->moves_count].origin = i;
+	cg->moves_count++;
+}
+
+int is_cgroup_populated(const char *path)
+{
+	char buffer[32];
+	int fd = open_cgroup_file(path, "cgroup.procs", O_RDONLY);
+	if (fd < 0) return 0;
+	ssize_t n = read(fd, buffer, sizeof(buffer));
+	close(fd);
+	return n > 0;
+}
+
+int move_to_cgroup(struct cpu_cgroup *cg, pid_t pid)
+{
+	char value[32];
+	save_origin(cg, pid);
+	sprintf(value, "%d\n", pid);
+	return write_cgroup_file(cg->path, "cgroup.procs", value);
+}
+
+//parent of a process, or -1 if it's gone
+static pid_t get_parent(pid_t pid)
+{
+	char file[32], buffer[1024];
+	sprintf(file, "/proc/%d/stat", pid);
+	int fd = open(file, O_RDONLY);
+	if (fd < 0) return -1;
+	ssize_t n = read(fd, buffer, sizeof(buffer) - 1);
+	close(fd);
+	if (n <= 0) return -1;
+	buffer[n] = '\0';
+	//the command name may contain spaces and parentheses
+	char *p = strrchr(buffer, ')');
+	int ppid;
+	if (p == NULL || sscanf(p + 1, " %*c %d", &ppid) != 1) return -1;
+	return ppid;
+}
+
+//cgroup a process in the cgroup was moved from (index in the origins): its
+//own if it was moved, or the one of the closest ancestor moved if it was
+//forked in the cgroup
+//return -1 for the processes cpulimit has nothing to do with
+static int find_origin(struct cpu_cgroup *cg, pid_t pid)
+{
+	int i, depth;
+	for (depth = 0; pid > 1 && depth < 64; depth++) {
+		//the latest move, the pid may have been reused
+		for (i=cg->moves_count-1; i>=0 && cg->moves[i].pid != pid; i--);
+		if (i >= 0) return cg->moves[i].origin;
+		pid = get_parent(pid);
+	}
+	return -1;
+}
+
+//move the processes moved to the cgroup, and their children forked in it,
+//back where they were; the other processes in a reused cgroup stay there
+static void restore_origins(struct cpu_cgroup *cg)
+{
+	char line[32], dir[PATH_MAX+1];
+	if (cg->origins_count == 0) return;
+	int fd = open_cgroup_file(cg->path, "cgroup.procs", O_RDONLY);
+	if (fd < 0) return;
+	FILE *procs = fdopen(fd, "r");
+	if (procs == NULL) {
+		close(fd);
+		return;
+	}
+	while (fgets(line, sizeof(line), procs) != NULL) {
+		pid_t pid = atoi(line);
+		if (pid <= 0) continue;
+		int origin = find_origin(cg, pid);
+		if (origin < 0) continue;
+		if (snprintf(dir, sizeof(dir), "%s%s", cg->root, cg->origins[origin]) >= (int)sizeof(dir)) continue;
+		write_cgroup_file(dir, "cgroup.procs", line);
+	}
+	fclose(procs);
+}
+
+int set_cgroup_limit(struct cpu_cgroup *cg, double cpus)
+{
+	char value[64];
+	long quota = -1;
+	if (cpus >= 0) {
+		quota = (long)(cpus * cg->period + 0.5);
+		if (quota < CGROUP_MIN_QUOTA) quota = CGROUP_MIN_QUOTA;
+	}
+	if (quota == cg->quota) return 0;
+	if (quota < 0) sprintf(value, "max %ld\n", cg->period);
+	else sprintf(value, "%ld %ld\n", quota, cg->period);
+	if (write_cgroup_file(cg->path, "cpu.max", value) != 0) return -1;
+	cg->quota = quota;
+	return 0;
+}
+
+int freeze_cgroup(struct cpu_cgroup *cg, int frozen)
+{
+	return pwrite(cg->freeze_fd, frozen ? "1\n" : "0\n", 2, 0) == 2 ? 0 : -1;
+}
+
+int is_cgroup_frozen(struct cpu_cgroup *cg)
+{
+	char buffer[256];
+	ssize_t n = pread(cg->events_fd, buffer, sizeof(buffer) - 1, 0);
+	if (n <= 0) return -1;
+	buffer[n] = '\0';
+	//one "key value" pair per line
+	char *p = strstr(buffer, "frozen ");
+	if (p == NULL || (p != buffer && p[-1] != '\n')) return -1;
+	return p[7] == '1';
+}
+
+void close_cgroup(struct cpu_cgroup *cg)
+{
+	int i;
+	if (cg->period > 0) set_cgroup_limit(cg, -1);
+	if (cg->freeze_fd >= 0) {
+		freeze_cgroup(cg, 0);
+		close(cg->freeze_fd);
+		close(cg->events_fd);
+		cg->freeze_fd = cg->events_fd = -1;
+	}
+	restore_origins(cg);
+	for (i=0; i<cg->origins_count; i++) free(cg->origins[i]);
+	free(cg->origins);
+	free(cg->moves);
+	cg->origins = NULL;
+	cg->moves = NULL;
+	cg->origins_count = cg->moves_count = 0;
+	//it fails while some processes are still in it
+	if (cg->created) rmdir(cg->path);
+}
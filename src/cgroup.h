@@ -0,0 +1,136 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __CGROUP_H
+
+#define __CGROUP_H
+
+#include <limits.h>
+#include <sys/types.h>
+
+//smallest quota accepted by the kernel (in microseconds)
+#define CGROUP_MIN_QUOTA 1000
+
+// a process moved to the cgroup
+struct cgroup_move {
+	pid_t pid;
+	//cgroup it was moved from (index in the origins)
+	int origin;
+};
+
+// a cgroup v2 leaf whose cpu.max enforces the limit in place of the signals
+struct cpu_cgroup {
+	//directory of the cgroup
+	char path[PATH_MAX+1];
+	//1 if the cgroup has been created, rather than reused
+	int created;
+	//period and quota written to cpu.max (in microseconds, quota -1 means max)
+	long period;
+	long quota;
+	//cgroup.freeze and cgroup.events, open when the processes are stopped
+	//and resumed by freezing the cgroup (-1 otherwise)
+	int freeze_fd;
+	int events_fd;
+	//mount point of the cgroup v2 hierarchy (empty if unknown)
+	char root[PATH_MAX+1];
+	//cgroups the processes were moved from (relative to root), and the
+	//processes moved, to move them back when closing
+	char **origins;
+	int origins_count;
+	struct cgroup_move *moves;
+	int moves_count;
+};
+
+/*
+ * Find the mount point of the cgroup v2 hierarchy
+ * return 0 on success, -1 if it is not mounted
+ */
+int find_cgroup_root(char *root, int size);
+
+/*
+ * Find the cgroup v2 of a process (pid 0 means the calling process),
+ * relative to the mount point ("" for the root cgroup)
+ * return 0 on success, -1 if it can't be read
+ */
+int find_process_cgroup(pid_t pid, char *path, int size);
+
+/*
+ * Create the cgroup, or reuse it if it exists, and make sure that its
+ * cpu.max can be written (enabling the cpu controller in the parent if
+ * needed)
+ * path can also be a plain directory standing in for cgroupfs, with the
+ * files the kernel would create in it
+ * return 0 on success, -1 if the cgroup can't be used
+ */
+int open_cgroup(struct cpu_cgroup *cg, const char *path, long period);
+
+/*
+ * Create the cgroup, or reuse it if it exists, to stop and resume all the
+ * processes in it at once through cgroup.freeze (Linux 5.2 or later, no
+ * controller is needed)
+ * return 0 on success, -1 if the cgroup can't be used
+ */
+int open_cgroup_freezer(struct cpu_cgroup *cg, const char *path);
+
+/*
+ * Return 1 if the cgroup in path holds some processes, 0 if it is empty or
+ * it doesn't exist
+ */
+int is_cgroup_populated(const char *path);
+
+/*
+ * Move a process, with all its threads, into the cgroup, remembering the
+ * cgroup it was in
+ * its children forked from now on start in it as well
+ * return 0 on success, -1 on error
+ */
+int move_to_cgroup(struct cpu_cgroup *cg, pid_t pid);
+
+/*
+ * Allow the processes in the cgroup to use the given number of cpus
+ * (negative means no limit), if it is not what they have already
+ * return 0 on success, -1 on error
+ */
+int set_cgroup_limit(struct cpu_cgroup *cg, double cpus);
+
+/*
+ * Freeze (frozen 1) or thaw (frozen 0) the processes in the cgroup
+ * the write returns at once, the processes freeze when they next leave the
+ * kernel (see is_cgroup_frozen())
+ * return 0 on success, -1 on error
+ */
+int freeze_cgroup(struct cpu_cgroup *cg, int frozen);
+
+/*
+ * Return 1 if all the processes in the cgroup are frozen, 0 if not yet,
+ * -1 if cgroup.events can't be read
+ */
+int is_cgroup_frozen(struct cpu_cgroup *cg);
+
+/*
+ * Remove the limit, thaw the processes, move the ones moved to the cgroup
+ * back where they were (the children forked in it where their ancestor
+ * was), and remove the cgroup as well if it was created and it is empty
+ * the other processes of a reused cgroup are left in it
+ */
+void close_cgroup(struct cpu_cgroup *cg);
+
+#endif
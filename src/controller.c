@@ -0,0 +1,98 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include "controller.h"
+
+#ifndef MIN
+#define MIN(a,b) (((a)<(b))?(a):(b))
+#endif
+#ifndef MAX
+#define MAX(a,b) (((a)>(b))?(a):(b))
+#endif
+
+void init_controller(struct controller *ctl, int type, double limit)
+{
+	ctl->type = type;
+	ctl->workingrate = MIN(limit, 1);
+	ctl->kp = PI_KP;
+	ctl->ki = PI_KI;
+	ctl->integral = ctl->workingrate;
+}
+
+void warm_start_controller(struct controller *ctl, double workingrate)
+{
+	ctl->workingrate = MAX(MIN(workingrate, 1), 0);
+	ctl->integral = ctl->workingrate;
+}
+
+//the historical algorithm: scale the working rate by limit/usage
+static double update_multiplicative(struct controller *ctl, double pcpu, double limit)
+{
+	return MIN(ctl->workingrate / pcpu * limit, 1);
+}
+
+//proportional-integral controller with anti-windup
+//the error is converted to working rate units using the demand of the group
+//(usage per unit of working rate), so that the loop gain does not depend
+//on how many cpus the processes are able to use
+static double update_pi(struct controller *ctl, double pcpu, double limit)
+{
+	double error;
+	if (pcpu <= 0) {
+		//processes are idle: let them run freely
+		error = 1;
+	}
+	else {
+		double demand = pcpu / MAX(ctl->workingrate, 0.001);
+		error = (limit - pcpu) / demand;
+	}
+	double output = ctl->integral + ctl->kp * error;
+	//anti-windup: don't integrate when the output is saturated
+	//and the error would push it further out of range
+	if (!(output >= 1 && error > 0) && !(output <= 0 && error < 0)) {
+		ctl->integral += ctl->ki * error;
+		ctl->integral = MAX(MIN(ctl->integral, 1), 0);
+	}
+	output = ctl->integral + ctl->kp * error;
+	return MAX(MIN(output, 1), 0);
+}
+
+double controller_update(struct controller *ctl, double pcpu, double limit)
+{
+	switch (ctl->type) {
+		case CONTROLLER_PI:
+			ctl->workingrate = update_pi(ctl, pcpu, limit);
+			break;
+		default:
+			ctl->workingrate = update_multiplicative(ctl, pcpu, limit);
+			break;
+	}
+	return ctl->workingrate;
+}
+
+int controller_type_by_name(const char *name)
+{
+	if (strcmp(name, "mult") == 0) return CONTROLLER_MULTIPLICATIVE;
+	if (strcmp(name, "pi") == 0) return CONTROLLER_PI;
+	return -1;
+}
@@ -0,0 +1,77 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __CONTROLLER_H
+
+#define __CONTROLLER_H
+
+//algorithms available to compute the working rate
+#define CONTROLLER_MULTIPLICATIVE 0
+#define CONTROLLER_PI 1
+
+//default gains of the PI controller (per control cycle)
+#ifndef PI_KP
+#define PI_KP 1.0
+#endif
+#ifndef PI_KI
+#define PI_KI 0.1
+#endif
+
+struct controller
+{
+	//algorithm in use (one of CONTROLLER_*)
+	int type;
+	//rate at which the processes are kept active (range 0-1)
+	//1 means that the processes are using all the slot
+	double workingrate;
+	//proportional and integral gains (PI only)
+	double kp;
+	double ki;
+	//integral term, expressed as a working rate (PI only)
+	double integral;
+};
+
+/*
+ * Initialize the controller for the given limit (range 0-NCPU)
+ * the working rate starts from the limit itself
+ */
+void init_controller(struct controller *ctl, int type, double limit);
+
+/*
+ * Start from a working rate known in advance, e.g. computed from the
+ * demand of the processes measured when attaching to them
+ */
+void warm_start_controller(struct controller *ctl, double workingrate);
+
+/*
+ * Compute the working rate for the next slot
+ * pcpu is the measured usage of the group, limit is the target usage
+ * return the new working rate (range 0-1)
+ */
+double controller_update(struct controller *ctl, double pcpu, double limit);
+
+/*
+ * Parse a controller name ("mult" or "pi")
+ * return the controller type, or -1 if the name is unknown
+ */
+int controller_type_by_name(const char *name);
+
+#endif
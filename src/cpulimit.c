@@ -48,6 +48,20 @@
 #endif
 
 #include "process_group.h"
+#include "controller.h"
+#include "slot.h"
+#include "share.h"
+#include "host_load.h"
+#include "protect.h"
+#include "schedule.h"
+#include "affinity.h"
+#include "demote.h"
+#include "profile.h"
+#include "actuator.h"
+#include "realtime.h"
+#include "thermal.h"
+#include "capacity.h"
+#include "cgroup.h"
 #include "list.h"
 
 #ifdef HAVE_SYS_SYSINFO_H
@@ -73,6 +87,72 @@
 
 #define MAX_PRIORITY -10
 
+//real-time priority of the actuator thread (SCHED_FIFO)
+#define RT_PRIORITY 10
+//timer slack of the limiter in real-time mode (in nanoseconds)
+#define RT_TIMER_SLACK 1
+//highest cpu usage of the actuator thread in real-time mode (range 0-1),
+//checked every RT_CHECK_CYCLES cycles
+#define RT_MAX_USAGE 0.1
+#define RT_CHECK_CYCLES 10
+
+//cycles after which the process groups that can be signalled at once are
+//looked for again, even if the members have not changed
+#define PGID_CHECK_CYCLES 10
+//cycles between two checks of the cpus available, which can be hotplugged
+//or have their quota changed at any time
+#define CAPACITY_CHECK_CYCLES 10
+
+//cpus left free for the rest of the host when adapting to the load
+#define LOAD_HEADROOM 0.2
+
+//adjustment of the limit under cpu pressure, per control cycle
+#define PRESSURE_DECREASE 0.8
+#define PRESSURE_INCREASE 1.05
+//lowest fraction of the limit kept under pressure
+#define PRESSURE_MIN_FACTOR 0.1
+
+//fraction of time a protected process may wait for a cpu before the limit is applied
+#define PROTECT_DELAY 0.05
+//headroom above the limit given back per control cycle, while protected processes don't wait
+#define PROTECT_INCREASE 0.02
+
+//largest change of the scheduled limit per control cycle (in cpus)
+#define SCHEDULE_STEP 0.1
+
+//time the processes are let run to measure their demand when attaching (in microseconds)
+#define CALIBRATION_TIME 100000
+//cycles a command started by cpulimit runs at the limit to measure its demand
+#define HELD_CALIBRATION_CYCLES 5
+//smoothing factor of the demand saved to the state file
+#define DEMAND_ALFA 0.05
+
+//smoothing factor of the stop latency of the members
+#define STOP_LATENCY_ALFA 0.3
+
+//largest change of the slot length allowed by --dither, as a fraction of TIME_SLOT
+#define MAX_DITHER 0.9
+
+//usage below which the group is considered idle, as a fraction of the limit
+#define IDLE_ENTER 0.5
+//usage at which the idle group is limited again, as a fraction of the limit
+#define IDLE_EXIT 0.8
+//control cycles under IDLE_ENTER before the group becomes idle
+#define IDLE_CYCLES 10
+//largest fraction of a cpu the mask may allow above the limit when it
+//enforces it alone, without signals
+#define AFFINITY_EXACT 0.01
+
+//usage over the limit tolerated by the demotion, as a fraction of the limit
+#define DEMOTE_TOLERANCE 0.05
+//usage below which the demotion is undone, as a fraction of the limit
+#define DEMOTE_RELEASE 0.5
+//control cycles over the limit before stopping the demoted processes, or
+//under it before going back to the demotion alone
+#define DEMOTE_CYCLES 20
+//control cycles well under the limit before undoing the demotion
+#define DEMOTE_RELEASE_CYCLES 100
+
 /* GLOBAL VARIABLES */
 
 //the "family"
@@ -82,8 +162,37 @@ pid_t cpulimit_pid;
 //name of this program (maybe cpulimit...)
 char *program_name;
 
-//number of cpu
-int NCPU;
+//cpus the processes can use: the online ones, as restricted by the
+//affinity mask, the cpuset and the cpu quota of the cgroup
+double NCPU;
+
+//cpus the processes are restricted to (affinity mode)
+struct affinity affinity;
+
+//thread sending the signals
+struct actuator actuator;
+
+//cgroup enforcing the limit in place of the signals (cgroup mode), or
+//frozen and thawed in place of them (freezer mode)
+struct cpu_cgroup cgroup;
+int use_cgroup = 0;
+int use_freezer = 0;
+
+//executable of the target process, and the last estimate of the group demand
+//(usage of the processes when free to run), saved to the state file on exit
+char profile_command[PATH_MAX+1];
+double group_demand = -1;
+
+//command run by cpulimit: it waits stopped until the limiter resumes it
+//with its first plan, and it is reaped by the limiter itself
+pid_t command_pid = 0;
+int command_exited = 0;
+int command_status = 0;
+
+//SIGINT or SIGTERM received (0 if none), and whether it was sent to
+//cpulimit alone: the handler only records it, the main thread quits
+volatile sig_atomic_t quit_signal = 0;
+volatile sig_atomic_t quit_from_user = 0;
 
 /* CONFIGURATION VARIABLES */
 
@@ -91,16 +200,123 @@ int NCPU;
 int verbose = 0;
 //lazy mode (exits if there is no process)
 int lazy = 0;
+//algorithm used to compute the working rate
+int controller_type = CONTROLLER_MULTIPLICATIVE;
+//number of phases in which the working slices of the members are staggered
+int stagger = 1;
+//rules splitting the budget among the members
+struct share_rule share_rules[MAX_SHARE_RULES];
+int share_rules_count = 0;
+//maximum burst credit, in seconds of cpu (0 means no bursts)
+double burst = 0;
+//storage I/O rate allowed to the group, in bytes per second (0 means no I/O limit)
+double io_limit = 0;
+//total cpu time allowed to the group, in seconds (0 means no budget)
+double budget = 0;
+//what to do when the budget is exhausted
+#define BUDGET_STOP 0
+#define BUDGET_KILL 1
+#define BUDGET_FLOOR 2
+int budget_action = BUDGET_STOP;
+//limit applied once the budget is exhausted (BUDGET_FLOOR only)
+double budget_floor = 0;
+//cpu time of the budget used so far, in seconds (kept when the target
+//process is found again)
+double budget_used = 0;
+//highest limit when adapting to the host load (0 means don't adapt)
+double load_ceiling = 0;
+//cpu pressure above which the limit is tightened (range 0-1, 0 means disabled)
+double pressure_threshold = 0;
+//temperature near which the limit is tightened, in degrees Celsius (0 means disabled)
+double thermal_threshold = 0;
+//file the temperature is read from
+const char *thermal_path = "/sys/class/thermal/thermal_zone0/temp";
+//processes that must not wait for a cpu because of the limited ones
+struct protected_set protect;
+//limits depending on the time of the day
+struct schedule_entry schedule[MAX_SCHEDULE_ENTRIES];
+int schedule_count = 0;
+//restrict the processes to as many cpus as the limit needs
+int use_affinity = 0;
+//demote the processes, and stop them only if it isn't enough
+int use_demotion = 0;
+//file keeping the demand of the executables limited in the past (NULL means none)
+const char *state_file = NULL;
+//fraction of TIME_SLOT by which the slots are randomly lengthened or shortened (0 means fixed slots)
+double dither = 0;
+//cgroup v2 the processes are moved to, to be limited by cpu.max (NULL means none)
+const char *cgroup_path = NULL;
+//stop and resume the processes in the cgroup through cgroup.freeze instead
+int cgroup_freeze = 0;
+//run the actuator thread with a real-time policy
+int realtime = 0;
+//cpu the threads sending the signals are pinned to (-1 means none)
+int limiter_cpu = -1;
+//longest sampling interval while the group is idle, in microseconds (0 means never idle)
+//a burst starting while idle exceeds the limit until the next sample,
+//so it is only done on request
+long idle_interval = 0;
+
+//remember the demand of the processes for the next time
+static void save_profile()
+{
+	if (state_file == NULL || profile_command[0] == '\0' || group_demand <= 0) return;
+	if (write_profile(state_file, profile_command, group_demand) != 0 && verbose)
+		fprintf(stderr, "Warning: cannot write the state file %s\n", state_file);
+}
+
+//print how long the members took to stop, over the whole run
+static void print_stop_histogram()
+{
+	long histogram[LATENESS_BUCKETS];
+	long total = 0;
+	int i;
+	if (!actuator.running) return;
+	long missed = get_stop_histogram(&actuator, histogram);
+	for (i=0; i<LATENESS_BUCKETS; i++) total += histogram[i];
+	if (total == 0) return;
+	if (use_freezer) printf("\nFreeze latency of %ld verified freezes, %ld of them not complete before the thaw\n", total, missed);
+	else printf("\nStop latency of %ld verified stops, %ld of them not effective before SIGCONT\n", total, missed);
+	for (i=0; i<LATENESS_BUCKETS; i++) {
+		if (histogram[i] == 0) continue;
+		if (i < LATENESS_BUCKETS - 1) printf("  < %7ld us\t%ld\n", 1L << i, histogram[i]);
+		else printf("  >= %6ld us\t%ld\n", 1L << (i - 1), histogram[i]);
+	}
+}
+
+//exit code of cpulimit for a terminated command, as a shell would give it
+static int command_exit_code(int status)
+{
+	if (WIFEXITED(status)) return WEXITSTATUS(status);
+	return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : EXIT_FAILURE;
+}
 
 //SIGINT and SIGTERM signal handler
+//it may interrupt the main thread holding the lock of the actuator, so
+//the cleanup is left to quit()
+static void handle_quit_signal(int sig, siginfo_t *info, void *context)
+{
+	quit_from_user = info != NULL && info->si_code == SI_USER;
+	quit_signal = sig;
+}
+
+//restore the processes and exit, after SIGINT or SIGTERM
 static void quit(int sig)
 {
+	//the actuator may be stopped already, between two targets
+	if (verbose && actuator.running) print_stop_histogram();
+	//no more signals must be sent after the processes are resumed
+	stop_actuator(&actuator);
+	save_profile();
+	if (use_cgroup || use_freezer) close_cgroup(&cgroup);
 	//let all the processes continue if stopped
 	struct list_node *node = NULL;
 	if (pgroup.proclist != NULL)
 	{
 		for (node = pgroup.proclist->first; node != NULL; node = node->next) {
 			struct process *p = (struct process*)(node->data);
+			if (use_affinity) reset_affinity(&affinity, p);
+			if (restore_process(p) != 0) fprintf(stderr, "Warning: cannot restore the priority of process %d\n", p->pid);
 			kill(p->pid, SIGCONT);
 		}
 		close_process_group(&pgroup);
@@ -108,23 +324,201 @@ static void quit(int sig)
 	//fix ^C little problem
 	printf("\r");
 	fflush(stdout);
+	//cpulimit is the parent of the command: give the caller its status
+	if (command_pid > 0) {
+		//the signals from the terminal reach the command as well, but
+		//not the ones sent to cpulimit alone
+		if (!command_exited && quit_from_user) kill(command_pid, sig);
+		if (command_exited || waitpid(command_pid, &command_status, 0) == command_pid) exit(command_exit_code(command_status));
+		exit(128 + sig);
+	}
 	exit(0);
 }
 
-//return t1-t2 in microseconds (no overflow checks, so better watch out!)
-static inline unsigned long timediff(const struct timeval *t1,const struct timeval *t2)
+//total cpu usage of the group (range 0-NCPU), or -1 if it is still unknown
+static double get_group_usage(struct process_group *pgroup)
+{
+	struct list_node *node;
+	double pcpu = -1;
+	for (node = pgroup->proclist->first; node != NULL; node = node->next) {
+		struct process *proc = (struct process*)(node->data);
+		if (proc->cpu_usage < 0) {
+			continue;
+		}
+		if (pcpu < 0) pcpu = 0;
+		pcpu += proc->cpu_usage;
+	}
+	return pcpu;
+}
+
+//run-queue wait time of the group (in ns), the members gone excluded
+static unsigned long long get_group_wait(struct process_group *pgroup)
+{
+	struct list_node *node;
+	unsigned long long total = 0, wait;
+	for (node = pgroup->proclist->first; node != NULL; node = node->next) {
+		struct process *proc = (struct process*)(node->data);
+		if (get_wait_time(proc->pid, &wait) == 0) total += wait;
+	}
+	return total;
+}
+
+//remove the dead members from the group
+static void remove_dead_members()
+{
+	struct list_node *node = pgroup.proclist->first;
+	while (node != NULL)
+	{
+		struct list_node *next_node = node->next;
+		struct process *proc = (struct process*)(node->data);
+		if (kill(proc->pid, 0) != 0) {
+			//process is dead, remove it from family
+			if (verbose) fprintf(stderr, "Process %d dead!\n", proc->pid);
+			//remove process from group
+			delete_node(pgroup.proclist, node);
+			remove_process(&pgroup, proc->pid);
+		}
+		node = next_node;
+	}
+}
+
+//set the scheduling policy of all the threads sending the signals
+//(0 means SCHED_OTHER)
+static int set_actuator_realtime(int priority)
+{
+	int i, ret = set_thread_realtime(actuator.thread, priority);
+	for (i=0; i<actuator.workers_count; i++) {
+		if (set_thread_realtime(actuator.workers[i], priority) != 0) ret = -1;
+	}
+	return ret;
+}
+
+//let all the threads sending the signals run only on the given cpu
+static int pin_actuator(int cpu)
+{
+	int i, ret = pin_thread(actuator.thread, cpu);
+	for (i=0; i<actuator.workers_count; i++) {
+		if (pin_thread(actuator.workers[i], cpu) != 0) ret = -1;
+	}
+	return ret;
+}
+
+//cpu time used by all the threads sending the signals (in seconds)
+static double get_actuator_cputime()
+{
+	int i;
+	double cputime = get_thread_cputime(actuator.thread);
+	for (i=0; i<actuator.workers_count; i++) cputime += get_thread_cputime(actuator.workers[i]);
+	return cputime;
+}
+
+//update the stop latency of the members verified by the actuator
+static void update_stop_latencies()
+{
+	struct stop_result results[MAX_STOP_RESULTS];
+	int i;
+	int count = get_stop_latencies(&actuator, results, MAX_STOP_RESULTS);
+	for (i=0; i<count; i++) {
+		struct process *proc = get_process(&pgroup, results[i].pid);
+		if (proc == NULL) continue;
+		proc->stop_latency = (1 - STOP_LATENCY_ALFA) * proc->stop_latency + STOP_LATENCY_ALFA * results[i].latency;
+	}
+}
+
+//collect the exit status of the command as soon as it terminates, so that
+//it doesn't stay in the group as a zombie
+static void reap_command()
 {
-	return (t1->tv_sec - t2->tv_sec) * 1000000 + (t1->tv_usec - t2->tv_usec);
+	if (command_pid <= 0 || command_exited) return;
+	if (waitpid(command_pid, &command_status, WNOHANG) == command_pid) command_exited = 1;
+}
+
+//move the members to the idle scheduling class
+static void demote_group()
+{
+	struct list_node *node;
+	for (node = pgroup.proclist->first; node != NULL; node = node->next) {
+		struct process *proc = (struct process*)(node->data);
+		if (!proc->demoted && demote_process(proc, get_process(&pgroup, proc->ppid)) != 0 && verbose)
+			fprintf(stderr, "Warning: cannot demote process %d\n", proc->pid);
+	}
+}
+
+//give the members back their original scheduling parameters
+static void restore_group()
+{
+	struct list_node *node;
+	for (node = pgroup.proclist->first; node != NULL; node = node->next) {
+		struct process *proc = (struct process*)(node->data);
+		//a process left in the idle class would stay there for good
+		if (restore_process(proc) != 0)
+			fprintf(stderr, "Warning: cannot restore the priority of process %d\n", proc->pid);
+	}
+}
+
+//ask all the members to terminate
+static void terminate_group()
+{
+	struct list_node *node;
+	for (node = pgroup.proclist->first; node != NULL; node = node->next) {
+		struct process *proc = (struct process*)(node->data);
+		kill(proc->pid, SIGTERM);
+		//stopped processes must be resumed to handle the signal
+		kill(proc->pid, SIGCONT);
+	}
 }
 
 static void print_usage(FILE *stream, int exit_code)
 {
 	fprintf(stream, "Usage: %s [OPTIONS...] TARGET\n", program_name);
 	fprintf(stream, "   OPTIONS\n");
-	fprintf(stream, "      -l, --limit=N          percentage of cpu allowed from 0 to %d (required)\n", 100*NCPU);
+	fprintf(stream, "      -l, --limit=N          percentage of cpu allowed from 0 to %d (required), checked\n", (int)(100*NCPU));
+	fprintf(stream, "                             against the cpus of the target with --pid, else of cpulimit\n");
 	fprintf(stream, "      -v, --verbose          show control statistics\n");
 	fprintf(stream, "      -z, --lazy             exit if there is no target process, or if it dies\n");
 	fprintf(stream, "      -i, --include-children limit also the children processes\n");
+	fprintf(stream, "      -c, --controller=TYPE  algorithm adjusting the working rate: mult (default) or pi\n");
+	fprintf(stream, "      -b, --burst=N          let unused budget build up to N seconds of cpu, to be spent\n");
+	fprintf(stream, "                             above the limit\n");
+	fprintf(stream, "      -L, --load-aware=N     raise the limit up to N percent while the rest of the host\n");
+	fprintf(stream, "                             leaves cpus idle (--limit is the minimum)\n");
+	fprintf(stream, "      -P, --pressure=N       tighten the limit while other tasks wait for a cpu more than N\n");
+	fprintf(stream, "                             percent of the time (from /proc/pressure/cpu)\n");
+	fprintf(stream, "      -T, --thermal=N        tighten the limit as the temperature approaches N degrees\n");
+	fprintf(stream, "                             Celsius, from %d degrees below it\n", THERMAL_BAND);
+	fprintf(stream, "      -Z, --thermal-zone=FILE read the temperature in millidegrees from FILE (default\n");
+	fprintf(stream, "                             %s)\n", thermal_path);
+	fprintf(stream, "      -x, --protect=NAME     run unlimited, and apply --limit only while the processes\n");
+	fprintf(stream, "                             named NAME wait for a cpu (can be repeated)\n");
+	fprintf(stream, "      -S, --schedule=ENTRY   use a different limit in a range of the day, ENTRY is\n");
+	fprintf(stream, "                             HH:MM-HH:MM=N (can be repeated, --limit applies elsewhere)\n");
+	fprintf(stream, "      -A, --affinity         restrict the processes to as many cpus as the limit needs,\n");
+	fprintf(stream, "                             using signals only for the fractional part, if any\n");
+	fprintf(stream, "      -G, --cgroup=DIR       move the processes to the cgroup v2 DIR (created if needed),\n");
+	fprintf(stream, "                             and let the kernel enforce the limit through cpu.max\n");
+	fprintf(stream, "      -F, --freeze           with --cgroup, stop and resume the processes by writing its\n");
+	fprintf(stream, "                             cgroup.freeze instead of cpu.max, all of them at once\n");
+	fprintf(stream, "      -d, --demote           move the processes to the idle scheduling class when they\n");
+	fprintf(stream, "                             exceed the limit, and stop them only if it's not enough\n");
+	fprintf(stream, "      -m, --idle-interval=MS while the processes stay well under the limit, stop sending\n");
+	fprintf(stream, "                             signals and sample them up to every MS ms (default 0,\n");
+	fprintf(stream, "                             sampling always every %d ms)\n", TIME_SLOT / 1000);
+	fprintf(stream, "      -f, --state-file=FILE  remember the cpu demand of the executables in FILE, to start\n");
+	fprintf(stream, "                             limiting them at the right rate the next time\n");
+	fprintf(stream, "      -j, --dither=N         change the length of the slots randomly by up to N percent,\n");
+	fprintf(stream, "                             and move the working slices in them (for periodic targets)\n");
+	fprintf(stream, "      -R, --realtime         send the signals from a SCHED_FIFO thread with locked memory\n");
+	fprintf(stream, "                             (needs root), leaving it if it uses more than %d%% cpu\n", (int)(RT_MAX_USAGE * 100));
+	fprintf(stream, "      -C, --limiter-cpu=N    run the threads sending the signals on cpu N\n");
+	fprintf(stream, "      -I, --io-limit=RATE    limit also the storage I/O to RATE bytes per second (or with a\n");
+	fprintf(stream, "                             suffix: K, M, G), enforcing the more restrictive of the limits\n");
+	fprintf(stream, "      -t, --budget=TIME      total cpu time allowed to the processes, in seconds\n");
+	fprintf(stream, "                             (or with a suffix: s, m, h)\n");
+	fprintf(stream, "      -a, --budget-action=A  when the budget is exhausted: stop (default) the processes,\n");
+	fprintf(stream, "                             kill them, or limit them to N percent\n");
+	fprintf(stream, "      -s, --stagger=N        spread the working slices of the members over N phases\n");
+	fprintf(stream, "      -w, --weight=RULE      give W%% of the budget to the members selected by RULE, which is\n");
+	fprintf(stream, "                             pid=N:W, name=FILE:W or depth=N:W (can be repeated)\n");
 	fprintf(stream, "      -h, --help             display this help and exit\n");
 	fprintf(stream, "   TARGET must be exactly one of these:\n");
 	fprintf(stream, "      -p, --pid=N            pid of the process (implies -z)\n");
@@ -150,22 +544,6 @@ static void increase_priority() {
 }
 
 /* Get the number of CPUs */
-static int get_ncpu() {
-	int ncpu;
-#ifdef _SC_NPROCESSORS_ONLN
-	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
-#elif defined __APPLE__
-	int mib[2] = {CTL_HW, HW_NCPU};
-	size_t len = sizeof(ncpu);
-	sysctl(mib, 2, &ncpu, &len, NULL, 0);
-#elif defined _GNU_SOURCE
-	ncpu = get_nprocs();
-#else
-	ncpu = -1;
-#endif
-	return ncpu;
-}
-
 int get_pid_max()
 {
 #ifdef __linux__
@@ -188,21 +566,31 @@ int get_pid_max()
 
 void limit_process(pid_t pid, double limit, int include_children)
 {
-	//slice of the slot in which the process is allowed to run
-	struct timespec twork;
-	//slice of the slot in which the process is stopped
-	struct timespec tsleep;
-	//when the last twork has started
-	struct timeval startwork;
-	//when the last twork has finished
-	struct timeval endwork;
-	//initialization
-	memset(&twork, 0, sizeof(struct timespec));
-	memset(&tsleep, 0, sizeof(struct timespec));
-	memset(&startwork, 0, sizeof(struct timeval));
-	memset(&endwork, 0, sizeof(struct timeval));	
-	//last working time in microseconds
-	unsigned long workingtime = 0;
+	//slice of the slot in which the process is allowed to run (in microseconds)
+	long twork = 0;
+	//slice of the slot in which the process is stopped (in microseconds)
+	long tsleep = 0;
+	//when the current sampling cycle has started (absolute monotonic time)
+	struct timespec startslot;
+	struct timespec now;
+	//length of the current slot, and position of the working slices in it
+	long slot = TIME_SLOT;
+	double position = 0;
+	unsigned int dither_seed = getpid() ^ time(NULL);
+	//signals to send in the current slot, filled for the actuator
+	struct slot_plan *plan;
+	//the command run by cpulimit is still stopped: it must not run before
+	//the first plan
+	int held = pid == command_pid;
+	//process groups made only of members, and the number of members when
+	//they were looked for
+	int batchable_pgids = 0;
+	int checked_members = 0;
+	//1 if the previous plan stopped the processes
+	//a held command is resumed by the first plan even when it doesn't stop it
+	int signalled = held;
+	//1 if the cpu mask alone enforces the limit, a whole number of cpus
+	int mask_enforced = 0;
 	//generic list item
 	struct list_node *node;
 	//counter
@@ -213,13 +601,199 @@ void limit_process(pid_t pid, double limit, int include_children)
 	
 	//build the family
 	init_process_group(&pgroup, pid, include_children);
+	//storage I/O of the processes, sampled in the same scan as their cpu usage
+	int io_aware = io_limit > 0;
+	if (io_aware && get_process_io(pid) < 0) {
+		fprintf(stderr, "Warning: cannot read the I/O of process %d, only the cpu will be limited\n", pid);
+		io_aware = 0;
+	}
+	pgroup.sample_io = io_aware;
+	//with a cgroup the kernel enforces the limit, the processes are only
+	//signalled when nothing is allowed
+	//with the freezer the stop/continue cycle is kept, but a single write
+	//stops or resumes the whole cgroup, children forked meanwhile included
+	if (cgroup_path != NULL && cgroup_freeze) {
+		if (is_cgroup_populated(cgroup_path)) {
+			//they would be stopped together with the limited processes
+			fprintf(stderr, "Warning: the cgroup %s holds other processes, using signals\n", cgroup_path);
+		}
+		else if (open_cgroup_freezer(&cgroup, cgroup_path) != 0) {
+			fprintf(stderr, "Warning: cannot freeze the cgroup %s, using signals\n", cgroup_path);
+		}
+		else if (held && (move_to_cgroup(&cgroup, pid) != 0 || freeze_cgroup(&cgroup, 1) != 0)) {
+			fprintf(stderr, "Warning: cannot freeze the command in the cgroup %s, using signals\n", cgroup_path);
+			close_cgroup(&cgroup);
+		}
+		else {
+			//a held command waits frozen instead of stopped, and the
+			//first plan thaws it
+			if (held) kill(pid, SIGCONT);
+			use_freezer = 1;
+			if (verbose) printf("Stopping the processes by freezing the cgroup %s\n", cgroup_path);
+		}
+	}
+	else if (cgroup_path != NULL) {
+		if (open_cgroup(&cgroup, cgroup_path, TIME_SLOT) != 0) {
+			fprintf(stderr, "Warning: cannot use the cgroup %s, using signals\n", cgroup_path);
+		}
+		else {
+			use_cgroup = 1;
+			if (verbose) printf("Limiting the processes with the cgroup %s\n", cgroup_path);
+		}
+	}
 
 	if (verbose) printf("Members in the process group owned by %d: %d\n", pgroup.target_pid, pgroup.proclist->count);
 
+	//limit of the current time of the day, or --limit if there is no schedule
+	double base = get_scheduled_limit(schedule, schedule_count, time(NULL));
+	if (base < 0) base = limit;
+
+	//controller of the rate at which we are keeping active the processes
+	struct controller ctl;
+	init_controller(&ctl, controller_type, base);
+
+	//warm start: find out the demand of the processes, from the state file
+	//or by letting them run for a short calibration sample, and start from
+	//the working rate that meets the limit
+	struct process *target_process = get_process(&pgroup, pid);
+	if (target_process != NULL && profile_command[0] == '\0') strcpy(profile_command, target_process->command);
+	double demand = -1;
+	if (state_file != NULL && profile_command[0] != '\0') {
+		demand = read_profile(state_file, profile_command);
+		if (verbose && demand >= 0) printf("Demand from the state file: %0.2lf%%\n", demand*100);
+	}
+	//a held command has no usage to measure yet: it runs at the initial
+	//working rate for a few cycles, and the controller starts after them
+	int calibrating = 0;
+	if (demand < 0 && held) {
+		calibrating = HELD_CALIBRATION_CYCLES;
+	}
+	else if (demand < 0) {
+		get_monotonic_time(&now);
+		timespec_add_us(&now, CALIBRATION_TIME);
+		sleep_until(&now);
+		update_process_group(&pgroup);
+		demand = get_group_usage(&pgroup);
+		if (verbose && demand >= 0) printf("Calibrated demand: %0.2lf%%\n", demand*100);
+	}
+	if (demand > 0) {
+		warm_start_controller(&ctl, base / demand);
+		group_demand = demand;
+	}
+	//the usage estimate starts again from the first slot at the new working
+	//rate, so that the controller doesn't react to the usage at full speed
+	for (node = pgroup.proclist->first; node != NULL; node = node->next) {
+		struct process *proc = (struct process*)(node->data);
+		proc->cpu_usage = -1;
+	}
 	//rate at which we are keeping active the processes (range 0-1)
 	//1 means that the process are using all the twork slice
 	double workingrate = -1;
+	//burst credit (in seconds of cpu), the group usage when it was last
+	//updated, and the usage allowed since then without the burst
+	double credit = 0;
+	double allowed = base;
+	double last_cputime = pgroup.cputime;
+	struct timespec last_credit;
+	//set when the cpu time budget has run out, and the group usage when
+	//the budget used was last updated
+	int budget_exhausted = 0;
+	double budget_cputime = pgroup.cputime;
+	//cpu usage of the rest of the host
+	struct host_load hload;
+	int load_aware = load_ceiling > 0;
+	if (load_aware && init_host_load(&hload, pgroup.cputime) != 0) {
+		fprintf(stderr, "Warning: cannot read the host load, the limit will not adapt to it\n");
+		load_aware = 0;
+	}
+	//cpu pressure of the host, and the fraction of the limit it allows
+	struct host_pressure hpressure;
+	double pressure_factor = 1;
+	int pressure_aware = pressure_threshold > 0;
+	if (pressure_aware && init_host_pressure(&hpressure, pressure_threshold, get_group_wait(&pgroup)) != 0) {
+		fprintf(stderr, "Warning: cannot read the cpu pressure, the limit will not adapt to it\n");
+		pressure_aware = 0;
+	}
+	if (pressure_aware && verbose && hpressure.trigger_fd < 0) {
+		printf("PSI triggers not available, sampling the cpu pressure\n");
+	}
+	//temperature of the host
+	struct thermal_zone tzone;
+	int thermal_aware = thermal_threshold > 0;
+	if (thermal_aware && init_thermal_zone(&tzone, thermal_path) != 0) {
+		fprintf(stderr, "Warning: cannot read the temperature from %s, the limit will not adapt to it\n", thermal_path);
+		thermal_aware = 0;
+	}
+	if (use_affinity && init_affinity(&affinity, pid, pid) != 0) {
+		fprintf(stderr, "Warning: cpu affinity is not supported, using only signals\n");
+		use_affinity = 0;
+	}
+	//fraction of the headroom above the limit allowed by the protected processes
+	double protect_factor = 1;
+	//enforcement stage with demotion: the processes are demoted, and
+	//stopped only when demoting them is not enough
+	int demoted = 0;
+	//a demotion that can't be undone would outlive cpulimit
+	int demotion = use_demotion;
+	if (demotion && can_restore_process(pid) == 0) {
+		fprintf(stderr, "Warning: the priority of process %d could not be restored after demoting it, using only signals (needs CAP_SYS_NICE or a higher RLIMIT_NICE)\n", pid);
+		demotion = 0;
+	}
+	int use_signals = !demotion && !use_cgroup;
+	//consecutive cycles in which the current stage looked too strict or too weak
+	int stage_cycles = 0;
+	//while idle the group is well under the limit: no signals are sent and
+	//the sampling interval doubles at every cycle, up to idle_interval
+	int idle = 0;
+	int idle_cycles = 0;
+	long interval = TIME_SLOT;
+	//group cpu time at the previous cycle, to measure the usage without delay
+	double sample_cputime = pgroup.cputime;
+	double sample_iobytes = pgroup.iobytes;
+	//storage I/O rate of the group when free to run (in bytes per second),
+	//and the working rate of the plan before the last one (the processes
+	//are running freely until the first plan)
+	double io_demand = -1;
+	double last_workingrate = 1;
+	struct timespec last_sample;
+	//show the limit in use, when it changes over time
+	int show_target = use_cgroup || load_aware || pressure_aware || thermal_aware || protect.names_count > 0 || schedule_count > 0;
+	//real-time mode: the actuator thread inherits the timer slack, and all
+	//its memory is locked, so that nothing delays the signals but the
+	//real-time tasks with a higher priority
+	int rt_active = realtime;
+	double rt_cputime = 0;
+	struct timespec rt_check;
+	if (realtime) {
+		if (set_timer_slack(RT_TIMER_SLACK) != 0)
+			fprintf(stderr, "Warning: cannot set the timer slack\n");
+		if (lock_memory() != 0)
+			fprintf(stderr, "Warning: cannot lock the memory. Run as root or raise RLIMIT_MEMLOCK.\n");
+	}
+	if (start_actuator(&actuator, TIME_SLOT, use_freezer ? &cgroup : NULL, verbose) != 0) {
+		fprintf(stderr, "Error: cannot start the actuator thread\n");
+		//nothing would ever resume the held command
+		if (held) {
+			kill(pid, SIGKILL);
+			waitpid(pid, NULL, 0);
+		}
+		if (use_cgroup || use_freezer) close_cgroup(&cgroup);
+		exit(1);
+	}
+	if (realtime && set_actuator_realtime(RT_PRIORITY) != 0) {
+		fprintf(stderr, "Warning: cannot use the real-time policy. Run as root for best results.\n");
+		rt_active = 0;
+	}
+	if (limiter_cpu >= 0 && pin_actuator(limiter_cpu) != 0)
+		fprintf(stderr, "Warning: cannot pin the limiter to cpu %d\n", limiter_cpu);
+	get_monotonic_time(&rt_check);
+	get_monotonic_time(&startslot);
+	struct timespec calibration_start = startslot;
+	double calibration_cputime = pgroup.cputime;
+	last_credit = startslot;
+	last_sample = startslot;
 	while(1) {
+		reap_command();
 		update_process_group(&pgroup);
 
 		if (pgroup.proclist->count==0) {
@@ -229,88 +803,410 @@ void limit_process(pid_t pid, double limit, int include_children)
 		
 		//total cpu actual usage (range 0-1)
 		//1 means that the processes are using 100% cpu
-		double pcpu = -1;
+		double pcpu = get_group_usage(&pgroup);
+		int i;
 
-		//estimate how much the controlled processes are using the cpu in the working interval
-		for (node = pgroup.proclist->first; node != NULL; node = node->next) {
-			struct process *proc = (struct process*)(node->data);
-			if (proc->cpu_usage < 0) {
-				continue;
+		if (c % CAPACITY_CHECK_CYCLES == 0) {
+			//the quota written by the limiter is no capacity of the host
+			double capacity = get_cpu_capacity(pid, use_cgroup ? cgroup.path : NULL);
+			if (capacity > 0 && capacity != NCPU) {
+				if (verbose) printf("Cpus available: %g\n", capacity);
+				NCPU = capacity;
+			}
+		}
+
+		if (schedule_count > 0) {
+			//move towards the limit of this time of the day in small steps,
+			//the controller keeps its state so there is no new transient
+			double scheduled = get_scheduled_limit(schedule, schedule_count, time(NULL));
+			if (scheduled < 0) scheduled = limit;
+			base += MAX(MIN(scheduled - base, SCHEDULE_STEP), -SCHEDULE_STEP);
+		}
+
+		//usage allowed in this slot
+		double target = base;
+		if (load_aware) {
+			//take the capacity left idle by the rest of the host, but
+			//never go below the base limit when the host is busy
+			double others = update_host_load(&hload, pgroup.cputime);
+			if (others >= 0) target = MAX(base, MIN(load_ceiling, NCPU - others - LOAD_HEADROOM));
+		}
+		if (burst > 0) {
+			//token bucket: the usage allowed and not used becomes credit, up
+			//to burst seconds, and the usage allowed by --load-aware is no debt
+			get_monotonic_time(&now);
+			credit += allowed * timespec_diff_us(&now, &last_credit) / 1000000.0 - (pgroup.cputime - last_cputime) / 1000.0;
+			credit = MAX(MIN(credit, burst), 0);
+			last_cputime = pgroup.cputime;
+			last_credit = now;
+			allowed = target;
+			//run at full speed only while the credit covers a whole slot, so
+			//that the bucket never goes into debt
+			//the burst only raises the ceiling, the policies below still
+			//tighten it
+			if (credit > (NCPU - target) * TIME_SLOT / 1000000.0) target = NCPU;
+		}
+		if (protect.names_count > 0) {
+			//limit the processes only when the protected ones wait for a cpu:
+			//cut the headroom above --limit according to the excess of delay,
+			//and give it back slowly while they don't wait
+			double delay = update_protected_set(&protect);
+			if (delay > PROTECT_DELAY)
+				protect_factor *= MAX(0.5, 1 - 0.5 * (delay - PROTECT_DELAY) / PROTECT_DELAY);
+			else if (delay >= 0 && delay < PROTECT_DELAY / 2)
+				protect_factor = MIN(protect_factor + PROTECT_INCREASE, 1);
+			double ceiling = load_aware ? target : NCPU;
+			target = base + (ceiling - base) * protect_factor;
+		}
+		if (pressure_aware) {
+			//tighten the limit while other tasks are waiting for a cpu more
+			//than the threshold, and relax it slowly when they stop waiting
+			int fired = update_host_pressure(&hpressure, get_group_wait(&pgroup));
+			if (fired > 0 || hpressure.some > pressure_threshold)
+				pressure_factor = MAX(pressure_factor * PRESSURE_DECREASE, PRESSURE_MIN_FACTOR);
+			else if (hpressure.some < pressure_threshold / 2)
+				pressure_factor = MIN(pressure_factor * PRESSURE_INCREASE, 1);
+			target *= pressure_factor;
+		}
+		if (thermal_aware) {
+			//slow the processes down before the temperature gets the
+			//hardware to throttle every cpu, whatever the burst credit
+			if (update_thermal_zone(&tzone) == 0)
+				target *= get_thermal_factor(tzone.temperature, thermal_threshold);
+		}
+
+		//cpu time budget left (in seconds)
+		budget_used += (pgroup.cputime - budget_cputime) / 1000.0;
+		budget_cputime = pgroup.cputime;
+		double remaining = budget - budget_used;
+		if (budget > 0 && remaining <= 0) {
+			if (budget_action == BUDGET_KILL) {
+				if (verbose) printf("CPU time budget exhausted, terminating the processes\n");
+				stop_actuator(&actuator);
+				terminate_group();
+				break;
+			}
+			if (verbose && !budget_exhausted) printf("CPU time budget exhausted\n");
+			budget_exhausted = 1;
+			target = budget_action == BUDGET_FLOOR ? MIN(target, budget_floor) : 0;
+		}
+
+		if (rt_active && c % RT_CHECK_CYCLES == 0) {
+			//safety cap: a real-time thread spinning would starve the host
+			double used = get_actuator_cputime();
+			get_monotonic_time(&now);
+			long elapsed = timespec_diff_us(&now, &rt_check);
+			if (c > 0 && elapsed > 0 && (used - rt_cputime) * 1000000 / elapsed > RT_MAX_USAGE) {
+				fprintf(stderr, "Warning: the limiter is using too much cpu, leaving the real-time mode\n");
+				set_actuator_realtime(0);
+				rt_active = 0;
+			}
+			rt_cputime = used;
+			rt_check = now;
+		}
+
+		//usage since the previous cycle, not smoothed
+		get_monotonic_time(&now);
+		long elapsed = timespec_diff_us(&now, &last_sample);
+		double sample = elapsed > 0 ? (pgroup.cputime - sample_cputime) * 1000 / elapsed : 0;
+		sample_cputime = pgroup.cputime;
+		last_sample = now;
+		//cpu usage alone, the controlled usage can include the I/O
+		double group_cpu = pcpu;
+		double io_rate = 0;
+		if (io_aware) {
+			io_rate = elapsed > 0 ? (pgroup.iobytes - sample_iobytes) * 1000000 / elapsed : 0;
+			sample_iobytes = pgroup.iobytes;
+			//the I/O rate at full speed is smoothed, not the I/O rate itself,
+			//which would lag behind the working rate
+			//the slot just sampled ran the plan before the last one, and maybe
+			//the last one from the middle
+			double sampled_rate = (workingrate + last_workingrate) / 2;
+			if (c > 0 && sampled_rate > 0) {
+				double observed = io_rate / sampled_rate;
+				io_demand = io_demand < 0 ? observed : (1 - DEMAND_ALFA) * io_demand + DEMAND_ALFA * observed;
+			}
+			if (c > 0) last_workingrate = workingrate;
+			//the I/O counts as the cpu usage at the same fraction of the
+			//target, so the controller enforces the more restrictive limit
+			if (io_demand >= 0 && pcpu >= 0 && target > 0) {
+				pcpu = MAX(pcpu, target * io_demand * ctl.workingrate / io_limit);
+				sample = MAX(sample, target * io_rate / io_limit);
+			}
+		}
+		if (idle_interval > 0 && pcpu >= 0) {
+			if (!idle) {
+				//enter the idle state only after the usage has been well
+				//under the limit for a while
+				if (pcpu < target * IDLE_ENTER && sample < target * IDLE_ENTER) idle_cycles++;
+				else idle_cycles = 0;
+				if (idle_cycles >= IDLE_CYCLES) {
+					if (verbose) printf("Usage well under the limit, going idle\n");
+					idle = 1;
+				}
+			}
+			else if (sample > target * IDLE_EXIT) {
+				//leave it as soon as one sample gets close to the limit
+				if (verbose) printf("Usage close to the limit, leaving idle\n");
+				idle = 0;
+				idle_cycles = 0;
+				interval = TIME_SLOT;
+			}
+			else {
+				interval = MIN(interval * 2, MAX(idle_interval, TIME_SLOT));
+			}
+		}
+
+		if (use_affinity) {
+			//restrict the processes to the whole cpus the limit needs, so
+			//that signals only have to enforce the fractional part of it
+			int ncpus = (int)target;
+			if (ncpus < target) ncpus++;
+			if (resize_affinity(&affinity, ncpus) && verbose) {
+				printf("Processes restricted to %d cpus\n", affinity.count);
+			}
+			//no fractional part left, as long as every member has the mask
+			//(the I/O limit and the weights still need the signals)
+			mask_enforced = affinity.count == ncpus && ncpus - target < AFFINITY_EXACT && !io_aware && share_rules_count == 0;
+			for (node = pgroup.proclist->first; node != NULL; node = node->next) {
+				struct process *proc = (struct process*)(node->data);
+				if (proc->mask_version == affinity.version) continue;
+				if (apply_affinity(&affinity, proc) == 0) proc->mask_version = affinity.version;
+				else mask_enforced = 0;
+			}
+		}
+
+		if (use_cgroup || use_freezer) {
+			//the children forked in the cgroup are in it already
+			for (node = pgroup.proclist->first; node != NULL; node = node->next) {
+				struct process *proc = (struct process*)(node->data);
+				if (proc->in_cgroup) continue;
+				if (move_to_cgroup(&cgroup, proc->pid) != 0 && verbose)
+					fprintf(stderr, "Warning: cannot move process %d to the cgroup\n", proc->pid);
+				proc->in_cgroup = 1;
+			}
+			if (use_cgroup && target > 0 && set_cgroup_limit(&cgroup, target) != 0) {
+				fprintf(stderr, "Warning: cannot write the cpu quota of the cgroup, using signals\n");
+				use_cgroup = 0;
+				use_signals = !demotion;
 			}
-			if (pcpu < 0) pcpu = 0;
-			pcpu += proc->cpu_usage;
 		}
 
+		if (demotion && pcpu >= 0 && target > 0) {
+			//graded enforcement: demote the processes as soon as they go over
+			//the limit, and fall back to the stop/continue cycle only when the
+			//demotion alone doesn't bring the usage under it for a while
+			if (!demoted) {
+				if (pcpu > target) {
+					if (verbose) printf("Usage over the limit, demoting the processes\n");
+					demoted = 1;
+					stage_cycles = 0;
+				}
+			}
+			else if (!use_signals) {
+				if (pcpu > target * (1 + DEMOTE_TOLERANCE)) {
+					stage_cycles = MAX(stage_cycles, 0) + 1;
+				}
+				else if (pcpu < target * DEMOTE_RELEASE) {
+					stage_cycles = MIN(stage_cycles, 0) - 1;
+				}
+				else {
+					stage_cycles = 0;
+				}
+				if (stage_cycles >= DEMOTE_CYCLES) {
+					if (verbose) printf("Demotion is not enough, stopping the processes\n");
+					//the processes have been running all the time so far
+					init_controller(&ctl, controller_type, 1);
+					use_signals = 1;
+					stage_cycles = 0;
+				}
+				else if (stage_cycles <= -DEMOTE_RELEASE_CYCLES) {
+					if (verbose) printf("Usage well under the limit, restoring the priorities\n");
+					restore_group();
+					demoted = 0;
+					stage_cycles = 0;
+				}
+			}
+			else {
+				//go back to the demotion alone when the controller lets the
+				//processes run all the time
+				stage_cycles = ctl.workingrate >= 1 ? stage_cycles + 1 : 0;
+				if (stage_cycles >= DEMOTE_CYCLES) {
+					if (verbose) printf("Usage under the limit, no longer stopping the processes\n");
+					use_signals = 0;
+					stage_cycles = 0;
+				}
+			}
+			//members appeared in the meantime are demoted as well
+			if (demoted) demote_group();
+		}
+		//the processes are always stopped when nothing is allowed
+		int signalling = (use_signals && !idle && !mask_enforced) || target <= 0;
+
 		//adjust work and sleep time slices
 		if (pcpu < 0) {
 			//it's the 1st cycle, initialize workingrate
-			pcpu = limit;
-			workingrate = limit;
-			twork.tv_nsec = TIME_SLOT * limit * 1000;
+			//the I/O limit is enforced as soon as it is known
+			pcpu = target;
+			workingrate = ctl.workingrate;
+			if (io_demand > io_limit) workingrate = MIN(workingrate, io_limit / io_demand);
+		}
+		else if (target <= 0) {
+			//keep the processes stopped, don't disturb the controller
+			workingrate = 0;
+		}
+		else if (!signalling) {
+			//the processes are idle, only demoted or held by the mask, let
+			//them run
+			//under a cpu quota or mask the usage is no measure of the demand
+			if (!use_cgroup && !mask_enforced) group_demand = group_cpu;
+			workingrate = 1;
+		}
+		else if (calibrating > 0) {
+			//the first samples of a held command are too short and too
+			//coarse for the controller: average them, then warm start it
+			workingrate = ctl.workingrate;
+			get_monotonic_time(&now);
+			long elapsed = timespec_diff_us(&now, &calibration_start);
+			if (--calibrating == 0 && elapsed > 0 && group_cpu > 0) {
+				double average = (pgroup.cputime - calibration_cputime) * 1000 / elapsed;
+				for (node = pgroup.proclist->first; node != NULL; node = node->next) {
+					struct process *proc = (struct process*)(node->data);
+					if (proc->cpu_usage > 0) proc->cpu_usage *= average / group_cpu;
+				}
+				group_demand = average / workingrate;
+				if (verbose) printf("Calibrated demand: %0.2lf%%\n", group_demand*100);
+				if (group_demand > 0) warm_start_controller(&ctl, target / group_demand);
+				workingrate = ctl.workingrate;
+			}
+			if (io_demand > io_limit) workingrate = MIN(workingrate, io_limit / io_demand);
 		}
 		else {
+			//the demand is smoothed again, the working rate changes at every cycle
+			if (ctl.workingrate >= 0.05) {
+				double observed = group_cpu / ctl.workingrate;
+				group_demand = group_demand < 0 ? observed : (1 - DEMAND_ALFA) * group_demand + DEMAND_ALFA * observed;
+			}
 			//adjust workingrate
-			workingrate = MIN(workingrate / pcpu * limit, 1);
-			twork.tv_nsec = TIME_SLOT * 1000 * workingrate;
+			workingrate = controller_update(&ctl, pcpu, target);
 		}
-		tsleep.tv_nsec = TIME_SLOT * 1000 - twork.tv_nsec;
+		//with dithering, the slot length and the position of the working
+		//slices change randomly at every slot, so that processes with their
+		//own period don't get locked in phase with the slots
+		slot = dither_slot(TIME_SLOT, dither, &dither_seed, &position);
+		twork = slot * workingrate;
+		tsleep = slot - twork;
 
 		if (verbose) {
-			if (c%200==0)
-				printf("\n%%CPU\twork quantum\tsleep quantum\tactive rate\n");
-			if (c%10==0 && c>0)
-				printf("%0.2lf%%\t%6ld us\t%6ld us\t%0.2lf%%\n", pcpu*100, twork.tv_nsec/1000, tsleep.tv_nsec/1000, workingrate*100);
+			if (c%200==0) {
+				printf("\n%%CPU\twork quantum\tsleep quantum\tactive rate");
+				if (show_target) printf("\tlimit");
+				if (burst > 0) printf("\tburst credit");
+				if (budget > 0) printf("\tbudget left");
+				if (io_aware) printf("\tI/O rate");
+				if (thermal_aware) printf("\ttemp");
+				printf("\tstop skew (mean/max)");
+				printf(use_freezer ? "\tfreeze latency (mean/p99/max)" : "\tstop latency (mean/p99/max)");
+				printf("\tedge error (mean/p99/max)");
+				printf("\n");
+			}
+			if (c%10==0 && c>0) {
+				printf("%0.2lf%%\t%6ld us\t%6ld us\t%0.2lf%%", group_cpu*100, twork, tsleep, workingrate*100);
+				if (show_target) printf("\t%0.2lf%%", target*100);
+				if (burst > 0) printf("\t%8.2lf s", credit);
+				if (budget > 0) printf("\t%8.2lf s", MAX(remaining, 0));
+				if (io_aware) printf("\t%8.0lf KB/s", io_rate / 1024);
+				if (thermal_aware) printf("\t%5.1lf C", tzone.temperature);
+				//time from the first to the last SIGSTOP of the same edge
+				double skew;
+				long max_skew;
+				get_skew_stats(&actuator, &skew, &max_skew);
+				printf("\t%5.0lf/%ld us", skew, max_skew);
+				//time the members took to stop
+				double stop_latency;
+				long p99_stop, max_stop;
+				get_stop_stats(&actuator, &stop_latency, &p99_stop, &max_stop);
+				printf("\t%5.0lf/%ld/%ld us", stop_latency, p99_stop, max_stop);
+				//lateness of the signals
+				double lateness;
+				long p99_lateness, max_lateness;
+				get_edge_stats(&actuator, &lateness, &p99_lateness, &max_lateness);
+				printf("\t%5.0lf/%ld/%ld us", lateness, p99_lateness, max_lateness);
+				printf("\n");
+			}
+		}
+
+		//with weights, every member gets its own part of the working slice
+		if (share_rules_count > 0) {
+			update_shares(&pgroup, share_rules, share_rules_count, target);
 		}
 
-		//resume processes
-		node = pgroup.proclist->first;
-		while (node != NULL)
-		{
-			struct list_node *next_node = node->next;
+		//plan the working slices
+		//by default all the processes are resumed together at the beginning
+		//of the slot, and stopped together when twork has elapsed
+		//with staggering, member i starts at phase i%stagger of the slot
+		//with dithering, the slices start at a random point, but they never
+		//wrap around the end of the slot
+		//when the processes are no longer stopped, they are resumed once
+		//with the freezer, the window of the first member is the one of the
+		//whole cgroup
+		plan = actuator.back;
+		clear_slot_plan(plan, slot);
+		i = 0;
+		for (node = pgroup.proclist->first; (signalling || signalled) && node != NULL; node = node->next, i++) {
 			struct process *proc = (struct process*)(node->data);
-			if (kill(proc->pid,SIGCONT) != 0) {
-				//process is dead, remove it from family
-				if (verbose) fprintf(stderr, "SIGCONT failed. Process %d dead!\n", proc->pid);
-				//remove process from group
-				delete_node(pgroup.proclist, node);
-				remove_process(&pgroup, proc->pid);
-			}
-			node = next_node;
+			long len = signalling ? twork * proc->share : slot;
+			proc->workingrate = (double)len / slot;
+			//the member keeps running until it actually stops, so stop it
+			//earlier by its stop latency, but let it start anyway
+			if (len > 0 && len < slot) len = MAX(len - (long)proc->stop_latency, 1);
+			if (use_freezer && i > 0) continue;
+			add_work_window(plan, proc, (i % stagger) * slot / stagger + (long)(position * (slot - len)), len);
 		}
+		sort_slot_plan(plan);
+		//the members making up whole process groups are signalled with a
+		//single kill() each
+		if (!use_freezer && pgroup.proclist->count > 1 && plan->count > 1 && (pgroup.proclist->count != checked_members || c % PGID_CHECK_CYCLES == 0)) {
+			int batchable = check_process_group_ids(&pgroup);
+			if (verbose && batchable != batchable_pgids) printf("Process groups signalled at once: %d\n", batchable);
+			batchable_pgids = batchable;
+			checked_members = pgroup.proclist->count;
+		}
+		if (batchable_pgids > 0) batch_slot_plan(plan);
+		signalled = signalling;
 
-		//now processes are free to run (same working slice for all)
-		gettimeofday(&startwork, NULL);
-		nanosleep(&twork, NULL);
-		gettimeofday(&endwork, NULL);
-		workingtime = timediff(&endwork, &startwork);
-		
-		long delay = workingtime - twork.tv_nsec/1000;
-		if (c>0 && delay>10000) {
-			//delay is too much! signal to user?
-			//fprintf(stderr, "%d %ld us\n", c, delay);
-		}
-
-		if (tsleep.tv_nsec>0) {
-			//stop processes only if tsleep>0
-			node = pgroup.proclist->first;
-			while (node != NULL)
-			{
-				struct list_node *next_node = node->next;
-				struct process *proc = (struct process*)(node->data);
-				if (kill(proc->pid,SIGSTOP)!=0) {
-					//process is dead, remove it from family
-					if (verbose) fprintf(stderr, "SIGSTOP failed. Process %d dead!\n", proc->pid);
-					//remove process from group
-					delete_node(pgroup.proclist, node);
-					remove_process(&pgroup, proc->pid);
-				}
-				node = next_node;
-			}
-			//now the processes are sleeping
-			nanosleep(&tsleep,NULL);
+		//the actuator sends the signals at their time from the beginning of
+		//its next slot, while the processes are scanned again
+		publish_plan(&actuator);
+
+		//the cycle ends at a fixed distance from its beginning, whatever
+		//happened in the middle, so that the period does not drift
+		timespec_add_us(&startslot, signalling ? slot : interval);
+		get_monotonic_time(&now);
+		if (timespec_diff_us(&now, &startslot) > 0) {
+			//the cycle has been overrun, restart the schedule from now
+			startslot = now;
 		}
+		while (!quit_signal && sleep_until_signal(&startslot) != 0);
+		if (quit_signal) quit(quit_signal);
+		if (get_failed_signals(&actuator)) remove_dead_members();
+		update_stop_latencies();
 		c++;
 	}
+	if (verbose) print_stop_histogram();
+	stop_actuator(&actuator);
+	save_profile();
+	if (pressure_aware) close_host_pressure(&hpressure);
+	if (thermal_aware) close_thermal_zone(&tzone);
+	if (use_cgroup || use_freezer) close_cgroup(&cgroup);
+	use_cgroup = 0;
+	use_freezer = 0;
+	//the members still alive get their own cpus back
+	for (node = pgroup.proclist->first; use_affinity && node != NULL; node = node->next) {
+		reset_affinity(&affinity, (struct process*)(node->data));
+	}
+	//the protected set is kept when the target is found again: its
+	//processes are not the limited ones, and it's initialised only once
 	close_process_group(&pgroup);
 }
 
@@ -330,13 +1226,15 @@ int main(int argc, char **argv) {
 	//get current pid
 	cpulimit_pid = getpid();
 	//get cpu count
-	NCPU = get_ncpu();
+	NCPU = get_cpu_capacity(0, NULL);
+	init_protected_set(&protect);
 
 	//parse arguments
+	char *end;
 	int next_option;
     int option_index = 0;
 	//A string listing valid short options letters
-	const char* short_options = "+p:e:l:vzih";
+	const char* short_options = "+p:e:l:c:b:I:t:a:L:P:T:Z:x:S:AG:Fdm:f:j:RC:s:w:vzih";
 	//An array describing valid long options
 	const struct option long_options[] = {
 		{ "pid",        required_argument, NULL, 'p' },
@@ -345,6 +1243,28 @@ int main(int argc, char **argv) {
 		{ "verbose",    no_argument,       NULL, 'v' },
 		{ "lazy",       no_argument,       NULL, 'z' },
 		{ "include-children", no_argument,  NULL, 'i' },
+		{ "controller", required_argument, NULL, 'c' },
+		{ "burst",      required_argument, NULL, 'b' },
+		{ "io-limit",   required_argument, NULL, 'I' },
+		{ "budget",     required_argument, NULL, 't' },
+		{ "budget-action", required_argument, NULL, 'a' },
+		{ "load-aware", required_argument, NULL, 'L' },
+		{ "pressure",   required_argument, NULL, 'P' },
+		{ "thermal",    required_argument, NULL, 'T' },
+		{ "thermal-zone", required_argument, NULL, 'Z' },
+		{ "protect",    required_argument, NULL, 'x' },
+		{ "schedule",   required_argument, NULL, 'S' },
+		{ "affinity",   no_argument,       NULL, 'A' },
+		{ "cgroup",     required_argument, NULL, 'G' },
+		{ "freeze",     no_argument,       NULL, 'F' },
+		{ "demote",     no_argument,       NULL, 'd' },
+		{ "idle-interval", required_argument, NULL, 'm' },
+		{ "state-file", required_argument, NULL, 'f' },
+		{ "dither",     required_argument, NULL, 'j' },
+		{ "realtime",   no_argument,       NULL, 'R' },
+		{ "limiter-cpu", required_argument, NULL, 'C' },
+		{ "stagger",    required_argument, NULL, 's' },
+		{ "weight",     required_argument, NULL, 'w' },
 		{ "help",       no_argument,       NULL, 'h' },
 		{ 0,            0,                 0,     0  }
 	};
@@ -373,6 +1293,153 @@ int main(int argc, char **argv) {
 			case 'i':
 				include_children = 1;
 				break;
+			case 'c':
+				controller_type = controller_type_by_name(optarg);
+				if (controller_type < 0) {
+					fprintf(stderr,"Error: Unknown controller '%s'\n", optarg);
+					print_usage(stderr, 1);
+				}
+				break;
+			case 'b':
+				burst = atof(optarg);
+				if (burst <= 0) {
+					fprintf(stderr,"Error: Invalid value for argument BURST\n");
+					print_usage(stderr, 1);
+				}
+				break;
+			case 'I':
+				io_limit = strtod(optarg, &end);
+				if (*end == 'K' || *end == 'k') io_limit *= 1024;
+				else if (*end == 'M' || *end == 'm') io_limit *= 1024 * 1024;
+				else if (*end == 'G' || *end == 'g') io_limit *= 1024 * 1024 * 1024;
+				if (io_limit <= 0 || (*end != '\0' && (strchr("KkMmGg", *end) == NULL || end[1] != '\0'))) {
+					fprintf(stderr,"Error: Invalid value for argument IO-LIMIT\n");
+					print_usage(stderr, 1);
+				}
+				break;
+			case 't':
+				budget = strtod(optarg, &end);
+				if (*end == 'm') budget *= 60;
+				else if (*end == 'h') budget *= 3600;
+				if (budget <= 0 || (*end != '\0' && strcmp(end, "s") != 0 && strcmp(end, "m") != 0 && strcmp(end, "h") != 0)) {
+					fprintf(stderr,"Error: Invalid value for argument BUDGET\n");
+					print_usage(stderr, 1);
+				}
+				break;
+			case 'a':
+				if (strcmp(optarg, "stop") == 0) {
+					budget_action = BUDGET_STOP;
+				}
+				else if (strcmp(optarg, "kill") == 0) {
+					budget_action = BUDGET_KILL;
+				}
+				else {
+					budget_action = BUDGET_FLOOR;
+					budget_floor = strtol(optarg, &end, 10) / 100.0;
+					if (*end != '\0' || budget_floor <= 0) {
+						fprintf(stderr,"Error: Invalid value for argument BUDGET-ACTION\n");
+						print_usage(stderr, 1);
+					}
+				}
+				break;
+			case 'L':
+				load_ceiling = atoi(optarg) / 100.0;
+				if (load_ceiling <= 0) {
+					fprintf(stderr,"Error: Invalid value for argument LOAD-AWARE\n");
+					print_usage(stderr, 1);
+				}
+				break;
+			case 'P':
+				pressure_threshold = atoi(optarg) / 100.0;
+				if (pressure_threshold <= 0 || pressure_threshold > 1) {
+					fprintf(stderr,"Error: Invalid value for argument PRESSURE\n");
+					print_usage(stderr, 1);
+				}
+				break;
+			case 'T':
+				thermal_threshold = strtod(optarg, &end);
+				if (*end != '\0' || thermal_threshold <= 0) {
+					fprintf(stderr,"Error: Invalid value for argument THERMAL\n");
+					print_usage(stderr, 1);
+				}
+				break;
+			case 'Z':
+				thermal_path = optarg;
+				break;
+			case 'x':
+				if (add_protected_name(&protect, optarg) != 0) {
+					fprintf(stderr,"Error: Too many protected processes (max %d)\n", MAX_PROTECTED_NAMES);
+					print_usage(stderr, 1);
+				}
+				break;
+			case 'S':
+				if (schedule_count == MAX_SCHEDULE_ENTRIES) {
+					fprintf(stderr,"Error: Too many schedule entries (max %d)\n", MAX_SCHEDULE_ENTRIES);
+					print_usage(stderr, 1);
+				}
+				if (parse_schedule_entry(optarg, &schedule[schedule_count]) != 0) {
+					fprintf(stderr,"Error: Invalid schedule entry '%s'\n", optarg);
+					print_usage(stderr, 1);
+				}
+				schedule_count++;
+				break;
+			case 'A':
+				use_affinity = 1;
+				break;
+			case 'G':
+				cgroup_path = optarg;
+				break;
+			case 'F':
+				cgroup_freeze = 1;
+				break;
+			case 'd':
+				use_demotion = 1;
+				break;
+			case 'm':
+				idle_interval = strtol(optarg, &end, 10) * 1000;
+				if (*end != '\0' || idle_interval < 0) {
+					fprintf(stderr,"Error: Invalid value for argument IDLE-INTERVAL\n");
+					print_usage(stderr, 1);
+				}
+				break;
+			case 'f':
+				state_file = optarg;
+				break;
+			case 'j':
+				dither = atoi(optarg) / 100.0;
+				if (dither <= 0 || dither > MAX_DITHER) {
+					fprintf(stderr,"Error: DITHER must be in the range 1-%d\n", (int)(MAX_DITHER * 100));
+					print_usage(stderr, 1);
+				}
+				break;
+			case 'R':
+				realtime = 1;
+				break;
+			case 'C':
+				limiter_cpu = strtol(optarg, &end, 10);
+				if (*end != '\0' || limiter_cpu < 0 || limiter_cpu >= get_online_cpus()) {
+					fprintf(stderr,"Error: LIMITER-CPU must be in the range 0-%d\n", get_online_cpus() - 1);
+					print_usage(stderr, 1);
+				}
+				break;
+			case 's':
+				stagger = atoi(optarg);
+				if (stagger < 1) {
+					fprintf(stderr,"Error: Invalid value for argument STAGGER\n");
+					print_usage(stderr, 1);
+				}
+				break;
+			case 'w':
+				if (share_rules_count == MAX_SHARE_RULES) {
+					fprintf(stderr,"Error: Too many weight rules (max %d)\n", MAX_SHARE_RULES);
+					print_usage(stderr, 1);
+				}
+				if (parse_share_rule(optarg, &share_rules[share_rules_count]) != 0) {
+					fprintf(stderr,"Error: Invalid weight rule '%s'\n", optarg);
+					print_usage(stderr, 1);
+				}
+				share_rules_count++;
+				break;
 			case 'h':
 				print_usage(stdout, 1);
 				break;
@@ -391,6 +1458,14 @@ int main(int argc, char **argv) {
 		print_usage(stderr, 1);
 		exit(1);
 	}
+	//the target may have other cpus than cpulimit, in another cgroup or
+	//cpuset: the limits are checked against its own
+	//a target found by name is only known later, and a command starts
+	//with the cpus of cpulimit
+	if (pid_ok) {
+		double capacity = get_cpu_capacity(pid, NULL);
+		if (capacity > 0) NCPU = capacity;
+	}
 	if (pid != 0) {
 		lazy = 1;
 	}
@@ -401,8 +1476,55 @@ int main(int argc, char **argv) {
 		exit(1);
 	}
 	double limit = perclimit / 100.0;
+	int i;
 	if (limit<0 || limit >NCPU) {
-		fprintf(stderr,"Error: limit must be in the range 0-%d00\n", NCPU);
+		fprintf(stderr,"Error: limit must be in the range 0-%d\n", (int)(100*NCPU));
+		print_usage(stderr, 1);
+		exit(1);
+	}
+
+	for (i=0; i<schedule_count; i++) {
+		if (schedule[i].limit > NCPU) {
+			fprintf(stderr,"Error: scheduled limits must be in the range 0-%d\n", (int)(100*NCPU));
+			print_usage(stderr, 1);
+			exit(1);
+		}
+	}
+
+	if (budget_action == BUDGET_FLOOR && budget_floor > NCPU) {
+		fprintf(stderr,"Error: budget floor must be in the range 1-%d\n", (int)(100*NCPU));
+		print_usage(stderr, 1);
+		exit(1);
+	}
+
+	if (load_ceiling > 0 && (load_ceiling < limit || load_ceiling > NCPU)) {
+		fprintf(stderr,"Error: load-aware limit must be in the range %d-%d\n", perclimit, (int)(100*NCPU));
+		print_usage(stderr, 1);
+		exit(1);
+	}
+
+	double total_weight = 0;
+	for (i=0; i<share_rules_count; i++) total_weight += share_rules[i].weight;
+	if (total_weight > 100) {
+		fprintf(stderr,"Error: The weights must not exceed 100%% in total\n");
+		print_usage(stderr, 1);
+		exit(1);
+	}
+
+	if (cgroup_freeze && cgroup_path == NULL) {
+		fprintf(stderr,"Error: --freeze needs a cgroup (--cgroup)\n");
+		print_usage(stderr, 1);
+		exit(1);
+	}
+
+	if (io_limit > 0 && cgroup_path != NULL && !cgroup_freeze) {
+		fprintf(stderr,"Error: cpu.max can't limit the storage I/O, --io-limit needs --freeze with --cgroup\n");
+		print_usage(stderr, 1);
+		exit(1);
+	}
+
+	if (cgroup_freeze && (stagger > 1 || share_rules_count > 0)) {
+		fprintf(stderr,"Error: the processes in a frozen cgroup all stop together, --stagger and --weight can't be used\n");
 		print_usage(stderr, 1);
 		exit(1);
 	}
@@ -421,11 +1543,15 @@ int main(int argc, char **argv) {
 	}
 
 	//all arguments are ok!
-	signal(SIGINT, quit);
-	signal(SIGTERM, quit);
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_sigaction = handle_quit_signal;
+	action.sa_flags = SA_SIGINFO;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
 
 	//print the number of available cpu
-	if (verbose) printf("%d cpu detected\n", NCPU);
+	if (verbose) printf("%g cpu available\n", NCPU);
 
 	if (command_mode) {
 		int i;
@@ -447,47 +1573,53 @@ int main(int argc, char **argv) {
 			printf("'\n");
 		}
 		
+		fflush(stdout);
 		int child = fork();
 		if (child < 0) {
 			exit(EXIT_FAILURE);
 		}
 		else if (child == 0) {
 			//target process code
+			//wait until the limiter has built the group and planned the
+			//first slot, so that the command never runs unlimited
+			kill(getpid(), SIGSTOP);
 			int ret = execvp(cmd, cmd_args);
 			//if we are here there was an error, show it
 			perror("Error");
 			exit(ret);
 		}
 		else {
-			//parent code
+			//limiter code
 			free(cmd_args);
-			int limiter = fork();
-			if (limiter < 0) {
+			int status_process;
+			pid_t ret;
+			while ((ret = waitpid(child, &status_process, WUNTRACED)) < 0 && errno == EINTR);
+			if (ret != child || !WIFSTOPPED(status_process)) {
+				fprintf(stderr, "Error: the command terminated before starting\n");
 				exit(EXIT_FAILURE);
 			}
-			else if (limiter > 0) {
-				//parent
-				int status_process;
-				int status_limiter;
-				waitpid(child, &status_process, 0);
-				waitpid(limiter, &status_limiter, 0);
-				if (WIFEXITED(status_process)) {
-					if (verbose) printf("Process %d terminated with exit status %d\n", child, (int)WEXITSTATUS(status_process));
-					exit(WEXITSTATUS(status_process));
-				}
-				printf("Process %d terminated abnormally\n", child);
-				exit(status_process);
+			command_pid = child;
+			//the profile of the command, not of cpulimit that it still is
+			strncpy(profile_command, cmd, sizeof(profile_command) - 1);
+			if (verbose) printf("Limiting process %d\n",child);
+			limit_process(child, limit, include_children);
+			while (!command_exited) {
+				if (waitpid(child, &command_status, 0) == child) command_exited = 1;
+				else if (errno != EINTR) break;
+				else if (quit_signal) quit(quit_signal);
 			}
-			else {
-				//limiter code
-				if (verbose) printf("Limiting process %d\n",child);
-				limit_process(child, limit, include_children);
-				exit(0);
+			status_process = command_status;
+			if (WIFEXITED(status_process)) {
+				if (verbose) printf("Process %d terminated with exit status %d\n", child, (int)WEXITSTATUS(status_process));
+				exit(WEXITSTATUS(status_process));
 			}
+			printf("Process %d terminated abnormally\n", child);
+			exit(command_exit_code(status_process));
 		}
 	}
 
 	while(1) {
+		if (quit_signal) quit(quit_signal);
 		//look for the target process..or wait for it
 		pid_t ret = 0;
 		if (pid_ok) {
@@ -526,5 +1658,7 @@ int main(int argc, char **argv) {
 		sleep(2);
 	};
 	
+	if (quit_signal) quit(quit_signal);
+	close_protected_set(&protect);
 	exit(0);
 }
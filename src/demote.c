@@ -0,0 +1,173 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "demote.h"
+
+#ifdef __linux__
+
+//set the scheduling policy, real-time priority and nice value of a thread
+static int set_thread_scheduling(pid_t tid, int policy, int rtprio, int nice)
+{
+	struct sched_param param;
+	param.sched_priority = rtprio;
+	if (sched_setscheduler(tid, policy, &param) != 0) return -1;
+	if (policy == SCHED_IDLE) return 0;
+	return setpriority(PRIO_PROCESS, tid, nice);
+}
+
+//apply the scheduling parameters to every thread of the process
+static int set_threads_scheduling(pid_t pid, int policy, int rtprio, int nice)
+{
+	char path[64];
+	struct dirent *dit;
+	int ret = 0;
+	sprintf(path, "/proc/%d/task", pid);
+	DIR *dip = opendir(path);
+	if (dip == NULL) return -1;
+	while ((dit = readdir(dip)) != NULL) {
+		if (dit->d_name[0] == '.') continue;
+		pid_t tid = atoi(dit->d_name);
+		if (set_thread_scheduling(tid, policy, rtprio, nice) == 0) continue;
+		//fall back to the lowest priority in the normal class
+		if (policy == SCHED_IDLE && setpriority(PRIO_PROCESS, tid, DEMOTED_NICE) == 0) continue;
+		ret = -1;
+	}
+	closedir(dip);
+	return ret;
+}
+
+int demote_process(struct process *p, const struct process *parent)
+{
+	struct sched_param param;
+	if (p->demoted) return 0;
+	//the parameters of the main thread are restored to all the threads
+	p->policy = sched_getscheduler(p->pid);
+	if (p->policy < 0 || sched_getparam(p->pid, &param) != 0) return -1;
+	p->rtprio = param.sched_priority;
+	errno = 0;
+	p->nice = getpriority(PRIO_PROCESS, p->pid);
+	if (p->nice == -1 && errno != 0) return -1;
+	if (parent != NULL && parent->demoted && (p->policy == SCHED_IDLE || p->nice == DEMOTED_NICE)) {
+		//forked while its parent was demoted: what it inherited is not
+		//its own, it gets what the parent had before
+		p->policy = parent->policy;
+		p->rtprio = parent->rtprio;
+		p->nice = parent->nice;
+	}
+	if (set_threads_scheduling(p->pid, SCHED_IDLE, 0, DEMOTED_NICE) != 0) {
+		//some threads may have been demoted, give them back their parameters
+		//so that the process is either demoted or not
+		set_threads_scheduling(p->pid, p->policy, p->rtprio, p->nice);
+		return -1;
+	}
+	p->demoted = 1;
+	return 0;
+}
+
+//1 if cpulimit has CAP_SYS_NICE, from its effective capabilities
+static int has_cap_sys_nice()
+{
+	char line[256];
+	unsigned long long caps;
+	int ret = 0;
+	FILE *fd = fopen("/proc/self/status", "r");
+	if (fd == NULL) return 0;
+	while (fgets(line, sizeof(line), fd) != NULL) {
+		if (sscanf(line, "CapEff: %llx", &caps) == 1) {
+			//CAP_SYS_NICE is capability 23
+			ret = (caps >> 23) & 1;
+			break;
+		}
+	}
+	fclose(fd);
+	return ret;
+}
+
+int can_restore_process(pid_t pid)
+{
+	struct sched_param param;
+	struct rlimit rl;
+	if (has_cap_sys_nice()) return 1;
+	int policy = sched_getscheduler(pid);
+	if (policy < 0 || sched_getparam(pid, &param) != 0) return -1;
+	errno = 0;
+	int nice = getpriority(PRIO_PROCESS, pid);
+	if (nice == -1 && errno != 0) return -1;
+	//leaving SCHED_IDLE and lowering the nice value are checked against
+	//the limits of the process itself
+	if (prlimit(pid, RLIMIT_NICE, NULL, &rl) != 0) return -1;
+	if (rl.rlim_cur != RLIM_INFINITY && 20 - nice > (long)rl.rlim_cur) return 0;
+	if (policy == SCHED_FIFO || policy == SCHED_RR) {
+		if (prlimit(pid, RLIMIT_RTPRIO, NULL, &rl) != 0) return -1;
+		if (rl.rlim_cur != RLIM_INFINITY && param.sched_priority > (long)rl.rlim_cur) return 0;
+	}
+	return 1;
+}
+
+int restore_process(struct process *p)
+{
+	if (!p->demoted) return 0;
+	p->demoted = 0;
+	return set_threads_scheduling(p->pid, p->policy, p->rtprio, p->nice);
+}
+
+#else
+
+int demote_process(struct process *p, const struct process *parent)
+{
+	if (p->demoted) return 0;
+	errno = 0;
+	p->nice = getpriority(PRIO_PROCESS, p->pid);
+	if (p->nice == -1 && errno != 0) return -1;
+	//forked while its parent was demoted
+	if (parent != NULL && parent->demoted && p->nice == DEMOTED_NICE) p->nice = parent->nice;
+	if (setpriority(PRIO_PROCESS, p->pid, DEMOTED_NICE) != 0) return -1;
+	p->demoted = 1;
+	return 0;
+}
+
+int can_restore_process(pid_t pid)
+{
+	errno = 0;
+	int nice = getpriority(PRIO_PROCESS, pid);
+	if (nice == -1 && errno != 0) return -1;
+	//only root can lower the nice value
+	return geteuid() == 0 || nice >= DEMOTED_NICE;
+}
+
+int restore_process(struct process *p)
+{
+	if (!p->demoted) return 0;
+	p->demoted = 0;
+	return setpriority(PRIO_PROCESS, p->pid, p->nice);
+}
+
+#endif
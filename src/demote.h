@@ -0,0 +1,58 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef __DEMOTE_H
+
+#define __DEMOTE_H
+
+#include "process_iterator.h"
+
+//nice value of the demoted processes, where SCHED_IDLE is not available
+#define DEMOTED_NICE 19
+
+/*
+ * Move all the threads of the process to the idle scheduling class
+ * (SCHED_IDLE, or the lowest nice value where it is not available),
+ * saving the original scheduling parameters in p
+ * parent (NULL if unknown) is the parent of the process: if it is demoted
+ * and the process has its idle class, inherited when it was forked, the
+ * original parameters of the parent are saved instead
+ * return 0 on success, -1 on error
+ */
+int demote_process(struct process *p, const struct process *parent);
+
+/*
+ * Return 1 if a process could be given back its scheduling parameters
+ * after being demoted: cpulimit is privileged, or the RLIMIT_NICE (and
+ * RLIMIT_RTPRIO) of the process allows them
+ * return 0 if not, -1 if the process can't be inspected
+ */
+int can_restore_process(pid_t pid);
+
+/*
+ * Give all the threads of a demoted process back the scheduling
+ * parameters saved by demote_process()
+ * return 0 on success, -1 on error
+ */
+int restore_process(struct process *p);
+
+#endif
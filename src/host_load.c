@@ -0,0 +1,189 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include "process_iterator.h"
+#include "host_load.h"
+
+//smoothing factor of the cpus used by the rest of the host (range 0-1)
+#define LOAD_ALFA 0.3
+
+#ifdef __linux__
+//read the cumulative busy time of all the cpus from /proc/stat
+static int read_busy_time(unsigned long long *busy)
+{
+	char buffer[256];
+	unsigned long long user, nice, system, idle, iowait, irq, softirq, steal;
+	FILE *fd = fopen("/proc/stat", "r");
+	if (fd == NULL) return -1;
+	if (fgets(buffer, sizeof(buffer), fd) == NULL) {
+		fclose(fd);
+		return -1;
+	}
+	fclose(fd);
+	steal = 0;
+	if (sscanf(buffer, "cpu %llu %llu %llu %llu %llu %llu %llu %llu", &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal) < 7)
+		return -1;
+	//guest time is already included in user and nice
+	*busy = user + nice + system + irq + softirq + steal;
+	return 0;
+}
+#else
+static int read_busy_time(unsigned long long *busy)
+{
+	return -1;
+}
+#endif
+
+int init_host_load(struct host_load *h, double group_cputime)
+{
+	h->other_cpus = -1;
+	h->group_cputime = group_cputime;
+	clock_gettime(CLOCK_MONOTONIC, &h->last_sample);
+	return read_busy_time(&h->busy);
+}
+
+double update_host_load(struct host_load *h, double group_cputime)
+{
+	unsigned long long busy;
+	struct timespec now;
+	if (read_busy_time(&busy) != 0) return -1;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	double dt = (now.tv_sec - h->last_sample.tv_sec) + (now.tv_nsec - h->last_sample.tv_nsec) / 1e9;
+	//the tick counters are too coarse for very short intervals
+	if (dt < 0.05) return h->other_cpus;
+	//busy cpus of the host, minus the ones used by the group in the same interval
+	double sample = (busy - h->busy) / HZ / dt - (group_cputime - h->group_cputime) / 1000.0 / dt;
+	if (sample < 0) sample = 0;
+	h->other_cpus = h->other_cpus < 0 ? sample : (1-LOAD_ALFA) * h->other_cpus + LOAD_ALFA * sample;
+	h->busy = busy;
+	h->group_cputime = group_cputime;
+	h->last_sample = now;
+	return h->other_cpus;
+}
+
+//window of the PSI trigger (in microseconds)
+//unprivileged users can only use multiples of 2 seconds
+#define PRESSURE_WINDOW 2000000
+
+#ifdef __linux__
+//read the cumulative "some" stall time
+static int read_some_total(int fd, unsigned long long *total)
+{
+	char buffer[256];
+	ssize_t n = pread(fd, buffer, sizeof(buffer) - 1, 0);
+	if (n <= 0) return -1;
+	buffer[n] = '\0';
+	char *p = strstr(buffer, "some ");
+	if (p == NULL) return -1;
+	p = strstr(p, "total=");
+	if (p == NULL) return -1;
+	*total = strtoull(p + 6, NULL, 10);
+	return 0;
+}
+
+int init_host_pressure(struct host_pressure *p, double threshold, unsigned long long group_wait)
+{
+	char trigger[64];
+	p->some = -1;
+	p->threshold = threshold;
+	p->group_wait = group_wait;
+	p->trigger_fd = -1;
+	p->fd = open("/proc/pressure/cpu", O_RDONLY);
+	if (p->fd < 0) return -1;
+	if (read_some_total(p->fd, &p->some_total) != 0) {
+		close(p->fd);
+		p->fd = -1;
+		return -1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &p->last_sample);
+	//register a trigger, so that a stall is noticed even if it is
+	//shorter than the sampling interval
+	int fd = open("/proc/pressure/cpu", O_RDWR | O_NONBLOCK);
+	if (fd >= 0) {
+		sprintf(trigger, "some %ld %d", (long)(threshold * PRESSURE_WINDOW), PRESSURE_WINDOW);
+		if (write(fd, trigger, strlen(trigger) + 1) < 0) {
+			close(fd);
+			fd = -1;
+		}
+	}
+	p->trigger_fd = fd;
+	return 0;
+}
+
+int update_host_pressure(struct host_pressure *p, unsigned long long group_wait)
+{
+	unsigned long long total;
+	struct timespec now;
+	int fired = 0;
+	//fraction of the interval the limited processes waited
+	double own = 0;
+	if (read_some_total(p->fd, &total) != 0) return -1;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	long dt = (now.tv_sec - p->last_sample.tv_sec) * 1000000 + (now.tv_nsec - p->last_sample.tv_nsec) / 1000;
+	if (dt > 0) {
+		//the wait time drops when a process of the group terminates
+		if (group_wait > p->group_wait) own = (group_wait - p->group_wait) / 1000.0 / dt;
+		p->some = (double)(total - p->some_total) / dt - own;
+		if (p->some > 1) p->some = 1;
+		if (p->some < 0) p->some = 0;
+		p->some_total = total;
+		p->group_wait = group_wait;
+		p->last_sample = now;
+	}
+	if (p->trigger_fd >= 0) {
+		struct pollfd fds;
+		fds.fd = p->trigger_fd;
+		fds.events = POLLPRI;
+		fired = poll(&fds, 1, 0) > 0 && (fds.revents & POLLPRI);
+	}
+	//the trigger counts the stall of the group as well
+	return fired && own < p->threshold;
+}
+
+void close_host_pressure(struct host_pressure *p)
+{
+	if (p->trigger_fd >= 0) close(p->trigger_fd);
+	if (p->fd >= 0) close(p->fd);
+	p->fd = p->trigger_fd = -1;
+}
+#else
+int init_host_pressure(struct host_pressure *p, double threshold, unsigned long long group_wait)
+{
+	p->fd = p->trigger_fd = -1;
+	return -1;
+}
+
+int update_host_pressure(struct host_pressure *p, unsigned long long group_wait)
+{
+	return -1;
+}
+
+void close_host_pressure(struct host_pressure *p)
+{
+}
+#endif
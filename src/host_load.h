@@ -0,0 +1,99 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __HOST_LOAD_H
+
+#define __HOST_LOAD_H
+
+#include <time.h>
+
+// sampler of the cpu usage of the whole host, from /proc/stat
+struct host_load {
+	//cumulative busy time of all the cpus at the last sample (in clock ticks)
+	unsigned long long busy;
+	//cpu time used by the limited processes at the last sample (in milliseconds)
+	double group_cputime;
+	//when the last sample was taken
+	struct timespec last_sample;
+	//cpus used by the other processes of the host, smoothed (range 0-number of cpus)
+	double other_cpus;
+};
+
+// sampler of the cpu pressure stall information, from /proc/pressure/cpu
+struct host_pressure {
+	//file descriptor to read the stall time
+	int fd;
+	//file descriptor of the PSI trigger, or -1 if triggers are not available
+	int trigger_fd;
+	//stall fraction the trigger fires at
+	double threshold;
+	//cumulative time in which some task was waiting for a cpu (in microseconds)
+	unsigned long long some_total;
+	//run-queue wait time of the limited processes at the last sample (in ns)
+	unsigned long long group_wait;
+	//when the last sample was taken
+	struct timespec last_sample;
+	//fraction of the last interval in which some task other than the
+	//limited processes was waiting (range 0-1)
+	double some;
+};
+
+/*
+ * Initialize the sampler
+ * group_cputime is the cpu time used so far by the limited processes (in ms)
+ * return 0 on success, -1 if the host load can't be read on this system
+ */
+int init_host_load(struct host_load *h, double group_cputime);
+
+/*
+ * Take a new sample, and update the cpus used by the rest of the host
+ * group_cputime is the cpu time used so far by the limited processes (in ms)
+ * return the number of cpus used by the other processes (smoothed), or -1 on error
+ */
+double update_host_load(struct host_load *h, double group_cputime);
+
+/*
+ * Initialize the pressure sampler
+ * a PSI trigger firing when the stall exceeds threshold (range 0-1) is
+ * registered, if the kernel lets us do so
+ * group_wait is the run-queue wait time of the limited processes so far (in ns)
+ * return 0 on success, -1 if the pressure can't be read on this system
+ */
+int init_host_pressure(struct host_pressure *p, double threshold, unsigned long long group_wait);
+
+/*
+ * Take a new sample of the stall time
+ * the processes being limited wait for a cpu themselves, and their wait
+ * time (group_wait, in ns) is subtracted from the stall: it is counted
+ * once per thread, so the stall of the rest of the host is underestimated
+ * when several of them wait at the same time
+ * return 1 if the trigger has fired since the last sample and the limited
+ * processes alone can't explain it, 0 otherwise and -1 on error
+ * the stall fraction of the last interval is stored in p->some
+ */
+int update_host_pressure(struct host_pressure *p, unsigned long long group_wait);
+
+/*
+ * Release the resources used by the pressure sampler
+ */
+void close_host_pressure(struct host_pressure *p);
+
+#endif
@@ -87,6 +87,10 @@ int init_process_group(struct process_group *pgroup, int target_pid, int include
 	pgroup->proclist = (struct list*)malloc(sizeof(struct list));
 	init_list(pgroup->proclist, 4);
 	memset(&pgroup->last_update, 0, sizeof(pgroup->last_update));
+	pgroup->cputime = 0;
+	pgroup->scans = 0;
+	pgroup->sample_io = 0;
+	pgroup->iobytes = 0;
 	update_process_group(pgroup);
 	return 0;
 }
@@ -124,6 +128,63 @@ static inline unsigned long timediff(const struct timeval *t1,const struct timev
 #define ALFA 0.08
 #define MIN_DT 20
 
+//account the I/O of a member since the previous sample
+static void update_process_io(struct process_group *pgroup, struct process *p)
+{
+	long long io_bytes = get_process_io(p->pid);
+	if (io_bytes < 0) return;
+	if (p->io_bytes >= 0) pgroup->iobytes += io_bytes - p->io_bytes;
+	p->io_bytes = io_bytes;
+}
+
+//fill in a member found for the first time from its sample, with the
+//state the limiter keeps about it reset
+static void init_new_process(struct process_group *pgroup, struct process *p, struct process *sample)
+{
+	memcpy(p, sample, sizeof(struct process));
+	p->cpu_usage = -1;
+	p->workingrate = -1;
+	p->share = 1;
+	p->mask_version = 0;
+	p->demoted = 0;
+	p->in_cgroup = 0;
+	p->stop_latency = 0;
+	p->pgid_members = 0;
+	p->io_bytes = pgroup->sample_io ? get_process_io(p->pid) : -1;
+	p->reaped_cputime = 0;
+	p->seen = pgroup->scans;
+	//processes appeared after the first scan are new children, account all their cpu time and I/O
+	if (pgroup->last_update.tv_sec != 0) {
+		pgroup->cputime += p->cputime + (pgroup->include_children ? p->children_cputime : 0);
+		if (p->io_bytes > 0) pgroup->iobytes += p->io_bytes;
+	}
+}
+
+//the members terminated since the previous update are gone with the cpu
+//time they used after it, but their parents got all of it when they waited
+//for them: account what the parents got, less what was accounted already
+static void account_reaped_members(struct process_group *pgroup)
+{
+	struct list_node *node;
+	int i;
+	for (i=0; i<PIDHASH_SZ; i++) {
+		if (pgroup->proctable[i] == NULL) continue;
+		for (node = pgroup->proctable[i]->first; node != NULL; node = node->next) {
+			struct process *p = (struct process*)(node->data);
+			//seen in the previous update, but not in this one
+			if (p->seen != pgroup->scans - 1) continue;
+			struct process *parent = get_process(pgroup, p->ppid);
+			if (parent != NULL && parent->seen == pgroup->scans) parent->reaped_cputime -= p->cputime + p->children_cputime;
+		}
+	}
+	//a parent not waiting for its children (SIGCHLD ignored) gets nothing
+	for (node = pgroup->proclist->first; node != NULL; node = node->next) {
+		struct process *p = (struct process*)(node->data);
+		if (p->reaped_cputime > 0) pgroup->cputime += p->reaped_cputime;
+		p->reaped_cputime = 0;
+	}
+}
+
 void update_process_group(struct process_group *pgroup)
 {
 	struct process_iterator it;
@@ -150,8 +211,7 @@ void update_process_group(struct process_group *pgroup)
 			//empty bucket
 			pgroup->proctable[hashkey] = malloc(sizeof(struct list));
 			struct process *new_process = malloc(sizeof(struct process));
-			tmp_process.cpu_usage = -1;
-			memcpy(new_process, &tmp_process, sizeof(struct process));
+			init_new_process(pgroup, new_process, &tmp_process);
 			init_list(pgroup->proctable[hashkey], 4);
 			add_elem(pgroup->proctable[hashkey], new_process);
 			add_elem(pgroup->proclist, new_process);
@@ -164,8 +224,7 @@ void update_process_group(struct process_group *pgroup)
 			{
 				//process is new. add it
 				struct process *new_process = malloc(sizeof(struct process));
-				tmp_process.cpu_usage = -1;
-				memcpy(new_process, &tmp_process, sizeof(struct process));
+				init_new_process(pgroup, new_process, &tmp_process);
 				add_elem(pgroup->proctable[hashkey], new_process);
 				add_elem(pgroup->proclist, new_process);
 			}
@@ -174,7 +233,13 @@ void update_process_group(struct process_group *pgroup)
 				assert(tmp_process.pid == p->pid);
 				assert(tmp_process.starttime == p->starttime);
 				add_elem(pgroup->proclist, p);
+				p->pgid = tmp_process.pgid;
+				p->seen = pgroup->scans;
+				if (pgroup->sample_io) update_process_io(pgroup, p);
 				if (dt < MIN_DT) continue;
+				//children waited for since the previous update
+				p->reaped_cputime += tmp_process.children_cputime - p->children_cputime;
+				p->children_cputime = tmp_process.children_cputime;
 				//process exists. update CPU usage
 				double sample = 1.0 * (tmp_process.cputime - p->cputime) / dt;
 				if (p->cpu_usage == -1) {
@@ -185,21 +250,111 @@ void update_process_group(struct process_group *pgroup)
 					//usage adjustment
 					p->cpu_usage = (1.0-ALFA) * p->cpu_usage + ALFA * sample;
 				}
+				pgroup->cputime += tmp_process.cputime - p->cputime;
 				p->cputime = tmp_process.cputime;
 			}
 		}
 	}
 	close_process_iterator(&it);
 	if (dt < MIN_DT) return;
+	if (pgroup->include_children) account_reaped_members(pgroup);
+	pgroup->scans++;
 	pgroup->last_update = now;
 }
 
+// a process group with members of the limited group
+struct pgid_count {
+	pid_t pgid;
+	//members in the process group, and processes in it on the whole system
+	int members;
+	int processes;
+};
+
+static int compare_pgid_counts(const void *a, const void *b)
+{
+	const struct pgid_count *c1 = (const struct pgid_count*)a;
+	const struct pgid_count *c2 = (const struct pgid_count*)b;
+	return c1->pgid < c2->pgid ? -1 : c1->pgid > c2->pgid;
+}
+
+int check_process_group_ids(struct process_group *pgroup)
+{
+	struct process_iterator it;
+	struct process proc;
+	struct process_filter filter;
+	struct list_node *node;
+	struct pgid_count key, *found;
+	int count = 0, complete = 0, i;
+	if (pgroup->proclist->count == 0) return 0;
+	struct pgid_count *counts = malloc(pgroup->proclist->count * sizeof(struct pgid_count));
+	//members in each process group
+	for (node = pgroup->proclist->first; node != NULL; node = node->next) {
+		counts[count].pgid = ((struct process*)(node->data))->pgid;
+		counts[count].members = 1;
+		counts[count].processes = 0;
+		count++;
+	}
+	qsort(counts, count, sizeof(struct pgid_count), compare_pgid_counts);
+	for (i=1, complete=1; i<count; i++) {
+		if (counts[i].pgid == counts[complete-1].pgid) counts[complete-1].members++;
+		else counts[complete++] = counts[i];
+	}
+	count = complete;
+	complete = 0;
+	//processes in each of them, members or not
+	filter.pid = 0;
+	filter.include_children = 0;
+	init_process_iterator(&it, &filter);
+	while (get_next_process(&it, &proc) != -1) {
+		key.pgid = proc.pgid;
+		found = bsearch(&key, counts, count, sizeof(struct pgid_count), compare_pgid_counts);
+		if (found != NULL) found->processes++;
+	}
+	close_process_iterator(&it);
+	//never the process group of cpulimit, and only if it is worth it
+	for (i=0; i<count; i++) {
+		if (counts[i].pgid <= 0 || counts[i].pgid == getpgrp() || counts[i].members < 2 || counts[i].members != counts[i].processes) counts[i].members = 0;
+		else complete++;
+	}
+	for (node = pgroup->proclist->first; node != NULL; node = node->next) {
+		struct process *p = (struct process*)(node->data);
+		key.pgid = p->pgid;
+		found = bsearch(&key, counts, count, sizeof(struct pgid_count), compare_pgid_counts);
+		p->pgid_members = found != NULL ? found->members : 0;
+	}
+	free(counts);
+	return complete;
+}
+
+struct process *get_process(struct process_group *pgroup, int pid)
+{
+	int hashkey = pid_hashfn(pid);
+	if (pgroup->proctable[hashkey] == NULL) return NULL;
+	return (struct process*)locate_elem(pgroup->proctable[hashkey], &pid);
+}
+
+int get_process_depth(struct process_group *pgroup, struct process *p)
+{
+	int depth = 0;
+	while (p != NULL && p->pid != pgroup->target_pid) {
+		//guard against loops caused by pid reuse
+		if (++depth > PIDHASH_SZ) return -1;
+		p = get_process(pgroup, p->ppid);
+	}
+	return p == NULL ? -1 : depth;
+}
+
 int remove_process(struct process_group *pgroup, int pid)
 {
 	int hashkey = pid_hashfn(pid);
 	if (pgroup->proctable[hashkey] == NULL) return 1; //nothing to delete
 	struct list_node *node = (struct list_node*)locate_node(pgroup->proctable[hashkey], &pid);
 	if (node == NULL) return 2;
+	//it won't be found missing by the next update: its parent, if it has
+	//waited for it, gets back what was accounted already
+	struct process *p = (struct process*)(node->data);
+	struct process *parent = get_process(pgroup, p->ppid);
+	if (pgroup->include_children && parent != NULL && p->seen == pgroup->scans - 1) parent->reaped_cputime -= p->cputime + p->children_cputime;
 	delete_node(pgroup->proctable[hashkey], node);
 	return 0;
 }
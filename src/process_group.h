@@ -38,6 +38,15 @@ struct process_group
 	pid_t target_pid;
 	int include_children;
 	struct timeval last_update;
+	//cpu time used by the members since the group was created (in milliseconds)
+	//with the children, including the members terminated between two scans
+	double cputime;
+	//scans in which the cpu usage has been updated
+	int scans;
+	//1 if the storage I/O of the members is sampled as well
+	int sample_io;
+	//bytes read and written by the members since their I/O is sampled
+	double iobytes;
 };
 
 int init_process_group(struct process_group *pgroup, int target_pid, int include_children);
@@ -52,4 +61,18 @@ int find_process_by_name(const char *process_name);
 
 int remove_process(struct process_group *pgroup, int pid);
 
+// find the process groups made only of members of the group, which can be
+// signalled with a single kill(-pgid), and set pgid_members accordingly
+// the whole system is scanned, so it should be called only when needed
+// return the number of such process groups
+int check_process_group_ids(struct process_group *pgroup);
+
+// look for a member of the group by pid
+// return NULL if the process is not in the group
+struct process *get_process(struct process_group *pgroup, int pid);
+
+// depth of a member in the tree of the target process (0 for the target itself)
+// return -1 if the member does not descend from the target
+int get_process_depth(struct process_group *pgroup, struct process *p);
+
 #endif
@@ -49,18 +49,52 @@
 #include <kvm.h>
 #endif
 
+//bytes of a cpu mask (cpu_set_t on Linux)
+#define CPU_MASK_SIZE 128
+
 // process descriptor
 struct process {
 	//pid of the process
 	pid_t pid;
 	//ppid of the process
 	pid_t ppid;
+	//process group of the process
+	pid_t pgid;
+	//members of the limited group in the process group, if no other
+	//process is in it (0 otherwise): they can all be signalled at once
+	int pgid_members;
 	//start time (unix timestamp)
 	int starttime;
 	//cputime used by the process (in milliseconds)
 	int cputime;
+	//cputime of its children terminated and waited for (in milliseconds)
+	int children_cputime;
+	//cputime of those children not accounted yet, and the last scan of the
+	//group the process was seen in (used by the process group)
+	int reaped_cputime;
+	int seen;
 	//actual cpu usage estimation (value in range 0-1)
 	double cpu_usage;
+	//fraction of the last slot in which the process was kept active (range 0-1)
+	double workingrate;
+	//fraction of the group working slice granted to the process (range 0-1)
+	double share;
+	//version of the cpu mask applied to the process (0 if none)
+	int mask_version;
+	//cpu mask of the process before the first one applied (empty if unknown)
+	unsigned char original_mask[CPU_MASK_SIZE];
+	//1 if the process has been moved to the idle scheduling class
+	int demoted;
+	//1 if the process has been moved to the cgroup enforcing the limit
+	int in_cgroup;
+	//scheduling policy, real-time priority and nice value before the demotion
+	int policy;
+	int rtprio;
+	int nice;
+	//time the process keeps running after SIGSTOP, as measured by the actuator (in microseconds)
+	double stop_latency;
+	//bytes read from and written to the storage by the process (-1 if unknown)
+	long long io_bytes;
 	//absolute path of the executable file
 	char command[PATH_MAX+1];
 };
@@ -94,4 +128,8 @@ int get_next_process(struct process_iterator *i, struct process *p);
 
 int close_process_iterator(struct process_iterator *i);
 
+// bytes read from and written to the storage by a process so far
+// return -1 if they are not available
+long long get_process_io(pid_t pid);
+
 #endif
@@ -76,13 +76,22 @@ static int pti2proc(struct proc_taskallinfo *ti, struct process *process) {
 	int bytes;
 	process->pid = ti->pbsd.pbi_pid;
 	process->ppid = ti->pbsd.pbi_ppid;
+	process->pgid = ti->pbsd.pbi_pgid;
 	process->starttime = ti->pbsd.pbi_start_tvsec;
 	process->cputime = (ti->ptinfo.pti_total_user + ti->ptinfo.pti_total_system) / 1000000;
+	//not available
+	process->children_cputime = 0;
 	bytes = strlen(ti->pbsd.pbi_comm);
 	memcpy(process->command, ti->pbsd.pbi_comm, (bytes < PATH_MAX ? bytes : PATH_MAX) + 1);
 	return 0;
 }
 
+long long get_process_io(pid_t pid) {
+	struct rusage_info_v2 ri;
+	if (proc_pid_rusage(pid, RUSAGE_INFO_V2, (rusage_info_t*)&ri) != 0) return -1;
+	return ri.ri_diskio_bytesread + ri.ri_diskio_byteswritten;
+}
+
 static int get_process_pti(pid_t pid, struct proc_taskallinfo *ti) {
 	int bytes;
 	bytes = proc_pidinfo(pid, PROC_PIDTASKALLINFO, 0, ti, sizeof(*ti));
@@ -46,7 +46,9 @@ static int kproc2proc(kvm_t *kd, struct kinfo_proc *kproc, struct process *proc)
 {
 	proc->pid = kproc->ki_pid;
 	proc->ppid = kproc->ki_ppid;
+	proc->pgid = kproc->ki_pgid;
 	proc->cputime = kproc->ki_runtime / 1000;
+	proc->children_cputime = (kproc->ki_childutime.tv_sec + kproc->ki_childstime.tv_sec) * 1000 + (kproc->ki_childutime.tv_usec + kproc->ki_childstime.tv_usec) / 1000;
 	proc->starttime = kproc->ki_start.tv_sec;
 	char **args = kvm_getargv(kd, kproc, sizeof(proc->command));
 	if (args == NULL) return -1;
@@ -54,6 +56,12 @@ static int kproc2proc(kvm_t *kd, struct kinfo_proc *kproc, struct process *proc)
 	return 0;
 }
 
+long long get_process_io(pid_t pid)
+{
+	//the rusage of the processes counts blocks, not bytes
+	return -1;
+}
+
 static int get_single_process(kvm_t *kd, pid_t pid, struct process *process)
 {
 	int count;
@@ -87,12 +87,18 @@ static int read_process_info(pid_t pid, struct process *p)
 	int i;
 	for (i=0; i<3; i++) token = strtok(NULL, " ");
 	p->ppid = atoi(token);
-	for (i=0; i<10; i++)
+	token = strtok(NULL, " ");
+	p->pgid = atoi(token);
+	for (i=0; i<9; i++)
 		token = strtok(NULL, " ");
 	p->cputime = atoi(token) * 1000 / HZ;
 	token = strtok(NULL, " ");
 	p->cputime += atoi(token) * 1000 / HZ;
-	for (i=0; i<7; i++)
+	token = strtok(NULL, " ");
+	p->children_cputime = atoi(token) * 1000 / HZ;
+	token = strtok(NULL, " ");
+	p->children_cputime += atoi(token) * 1000 / HZ;
+	for (i=0; i<5; i++)
 		token = strtok(NULL, " ");
 	p->starttime = atoi(token) / sysconf(_SC_CLK_TCK);
 	//read command line
@@ -107,6 +113,26 @@ static int read_process_info(pid_t pid, struct process *p)
 	return 0;
 }
 
+long long get_process_io(pid_t pid)
+{
+	char iofile[32];
+	char buffer[256];
+	long long value, bytes = 0;
+	int found = 0;
+	//only readable by the owner of the process, or with CAP_SYS_PTRACE
+	sprintf(iofile, "/proc/%d/io", pid);
+	FILE *fd = fopen(iofile, "r");
+	if (fd==NULL) return -1;
+	while (fgets(buffer, sizeof(buffer), fd) != NULL) {
+		if (sscanf(buffer, "read_bytes: %lld", &value) == 1 || sscanf(buffer, "write_bytes: %lld", &value) == 1) {
+			bytes += value;
+			found++;
+		}
+	}
+	fclose(fd);
+	return found == 2 ? bytes : -1;
+}
+
 static pid_t getppid_of(pid_t pid)
 {
 	char statfile[20];
@@ -0,0 +1,104 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+
+#include "profile.h"
+
+//read a line of the state file, return 0 on success
+static int parse_profile_line(char *line, double *demand, char **command)
+{
+	char *end;
+	line[strcspn(line, "\n")] = '\0';
+	*demand = strtod(line, &end);
+	if (end == line || *end != ' ' || *demand < 0) return -1;
+	*command = end + 1;
+	return 0;
+}
+
+double read_profile(const char *file, const char *command)
+{
+	char line[PATH_MAX + 64];
+	double demand = -1;
+	FILE *fd = fopen(file, "r");
+	if (fd == NULL) return -1;
+	while (fgets(line, sizeof(line), fd) != NULL) {
+		double d;
+		char *c;
+		if (parse_profile_line(line, &d, &c) == 0 && strcmp(c, command) == 0) {
+			demand = d;
+			break;
+		}
+	}
+	fclose(fd);
+	return demand;
+}
+
+int write_profile(const char *file, const char *command, double demand)
+{
+	char line[PATH_MAX + 64];
+	char tmpfile[PATH_MAX + 1];
+	char lockfile[PATH_MAX + 1];
+	int count = 0;
+	if (snprintf(tmpfile, sizeof(tmpfile), "%s.%d", file, (int)getpid()) >= (int)sizeof(tmpfile)) return -1;
+	if (snprintf(lockfile, sizeof(lockfile), "%s.lock", file) >= (int)sizeof(lockfile)) return -1;
+	//the file is replaced, so another instance writing at the same time
+	//would drop this profile: serialize the writers on a separate lock
+	int lock = open(lockfile, O_RDWR | O_CREAT, 0644);
+	if (lock < 0) return -1;
+	if (flock(lock, LOCK_EX) != 0) {
+		close(lock);
+		return -1;
+	}
+	FILE *out = fopen(tmpfile, "w");
+	if (out == NULL) {
+		close(lock);
+		return -1;
+	}
+	fprintf(out, "%.4lf %s\n", demand, command);
+	//copy the other profiles, the most recent ones first
+	FILE *in = fopen(file, "r");
+	if (in != NULL) {
+		while (count < MAX_PROFILES - 1 && fgets(line, sizeof(line), in) != NULL) {
+			double d;
+			char *c;
+			if (parse_profile_line(line, &d, &c) != 0 || strcmp(c, command) == 0) continue;
+			fprintf(out, "%.4lf %s\n", d, c);
+			count++;
+		}
+		fclose(in);
+	}
+	if (fclose(out) != 0 || rename(tmpfile, file) != 0) {
+		remove(tmpfile);
+		close(lock);
+		return -1;
+	}
+	//closing the lock file releases the lock
+	close(lock);
+	return 0;
+}
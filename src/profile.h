@@ -0,0 +1,51 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef __PROFILE_H
+
+#define __PROFILE_H
+
+//maximum number of profiles kept in a state file
+#define MAX_PROFILES 1024
+
+/*
+ * A state file keeps the cpu demand of the executables limited in the past,
+ * that is the usage they reach when they are free to run (range 0-NCPU),
+ * one per line: "DEMAND PATH"
+ */
+
+/*
+ * Look for the demand of an executable in the state file
+ * return the demand, or -1 if the executable is unknown or the file
+ * cannot be read
+ */
+double read_profile(const char *file, const char *command);
+
+/*
+ * Store the demand of an executable in the state file, replacing the
+ * previous one. The file is replaced atomically, and the writers are
+ * serialized by a lock on FILE.lock
+ * return 0 on success, -1 on error
+ */
+int write_profile(const char *file, const char *command, double demand);
+
+#endif
@@ -0,0 +1,158 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include "process_iterator.h"
+#include "protect.h"
+
+//control cycles between two scans for new protected processes
+#define PROTECT_RESCAN 50
+//smoothing factor of the delay (range 0-1)
+#define PROTECT_ALFA 0.3
+
+void init_protected_set(struct protected_set *ps)
+{
+	ps->names_count = 0;
+	ps->procs = NULL;
+	ps->count = 0;
+	ps->size = 0;
+	ps->rescan = 0;
+	ps->delay = -1;
+}
+
+int add_protected_name(struct protected_set *ps, char *name)
+{
+	if (ps->names_count == MAX_PROTECTED_NAMES) return -1;
+	ps->names[ps->names_count++] = name;
+	return 0;
+}
+
+#ifdef __linux__
+int get_wait_time(pid_t pid, unsigned long long *wait)
+{
+	char path[300];
+	struct dirent *dit;
+	sprintf(path, "/proc/%d/task", pid);
+	DIR *dip = opendir(path);
+	if (dip == NULL) return -1;
+	*wait = 0;
+	while ((dit = readdir(dip)) != NULL) {
+		unsigned long long cpu, w;
+		if (dit->d_name[0] == '.') continue;
+		snprintf(path, sizeof(path), "/proc/%d/task/%s/schedstat", pid, dit->d_name);
+		FILE *fd = fopen(path, "r");
+		if (fd == NULL) continue;
+		if (fscanf(fd, "%llu %llu", &cpu, &w) == 2) *wait += w;
+		fclose(fd);
+	}
+	closedir(dip);
+	return 0;
+}
+#else
+int get_wait_time(pid_t pid, unsigned long long *wait)
+{
+	return -1;
+}
+#endif
+
+//look for the processes matching the names, keeping the samples of the known ones
+static void scan_protected_processes(struct protected_set *ps)
+{
+	struct process_iterator it;
+	struct process proc;
+	struct process_filter filter;
+	struct protected_process *procs = NULL;
+	int count = 0, size = 0;
+	int i;
+	filter.pid = 0;
+	filter.include_children = 0;
+	init_process_iterator(&it, &filter);
+	while (get_next_process(&it, &proc) != -1) {
+		int match = 0;
+		//the name of the executable, without the path
+		const char *name = strrchr(proc.command, '/');
+		name = name != NULL ? name + 1 : proc.command;
+		for (i=0; i<ps->names_count && !match; i++) {
+			match = strncmp(name, ps->names[i], strlen(ps->names[i])) == 0;
+		}
+		if (!match) continue;
+		if (count == size) {
+			size = size == 0 ? 8 : size * 2;
+			procs = (struct protected_process*)realloc(procs, size * sizeof(struct protected_process));
+			if (procs == NULL) exit(2);
+		}
+		procs[count].pid = proc.pid;
+		//keep the last sample if the process was already known
+		procs[count].wait = 0;
+		for (i=0; i<ps->count; i++) {
+			if (ps->procs[i].pid == proc.pid) procs[count].wait = ps->procs[i].wait;
+		}
+		if (procs[count].wait == 0 && get_wait_time(proc.pid, &procs[count].wait) != 0) continue;
+		count++;
+	}
+	close_process_iterator(&it);
+	free(ps->procs);
+	ps->procs = procs;
+	ps->count = count;
+	ps->size = size;
+}
+
+double update_protected_set(struct protected_set *ps)
+{
+	struct timespec now;
+	int i;
+	if (ps->rescan-- <= 0) {
+		scan_protected_processes(ps);
+		ps->rescan = PROTECT_RESCAN;
+		if (ps->delay < 0) {
+			//first samples, nothing to compare with yet
+			clock_gettime(CLOCK_MONOTONIC, &ps->last_sample);
+			ps->delay = 0;
+			return -1;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	double dt = (now.tv_sec - ps->last_sample.tv_sec) * 1e9 + (now.tv_nsec - ps->last_sample.tv_nsec);
+	if (dt <= 0) return ps->delay;
+	double worst = 0;
+	for (i=0; i<ps->count; i++) {
+		unsigned long long wait;
+		if (get_wait_time(ps->procs[i].pid, &wait) != 0) continue;
+		if (wait >= ps->procs[i].wait && (wait - ps->procs[i].wait) / dt > worst)
+			worst = (wait - ps->procs[i].wait) / dt;
+		ps->procs[i].wait = wait;
+	}
+	ps->last_sample = now;
+	ps->delay = (1-PROTECT_ALFA) * ps->delay + PROTECT_ALFA * worst;
+	return ps->delay;
+}
+
+void close_protected_set(struct protected_set *ps)
+{
+	free(ps->procs);
+	ps->procs = NULL;
+	ps->count = 0;
+	ps->size = 0;
+}
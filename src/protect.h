@@ -0,0 +1,85 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __PROTECT_H
+
+#define __PROTECT_H
+
+#include <time.h>
+#include <sys/types.h>
+
+#define MAX_PROTECTED_NAMES 16
+
+// a protected process, with its cumulative run-queue wait time
+struct protected_process {
+	pid_t pid;
+	//time spent waiting for a cpu by all its threads (in nanoseconds)
+	unsigned long long wait;
+};
+
+// set of processes whose scheduling delay drives the limit
+struct protected_set {
+	//names of the executables to protect
+	char *names[MAX_PROTECTED_NAMES];
+	int names_count;
+	//processes currently matching the names
+	struct protected_process *procs;
+	int count;
+	int size;
+	//cycles left before looking again for processes matching the names
+	int rescan;
+	//when the last sample was taken
+	struct timespec last_sample;
+	//largest fraction of time a protected process spent waiting (smoothed)
+	double delay;
+};
+
+/*
+ * Read the time spent waiting on a run-queue by all the threads of a
+ * process (in nanoseconds), from their schedstat
+ * return 0 on success, -1 if the process is gone or it's not supported
+ */
+int get_wait_time(pid_t pid, unsigned long long *wait);
+
+/*
+ * Initialize a set of protected processes
+ */
+void init_protected_set(struct protected_set *ps);
+
+/*
+ * Add the name of an executable to protect
+ * return 0 on success, -1 if there are too many names
+ */
+int add_protected_name(struct protected_set *ps, char *name);
+
+/*
+ * Sample the run-queue wait time of the protected processes
+ * return the largest fraction of time in which one of them was waiting
+ * for a cpu (smoothed), or -1 if it's not known yet
+ */
+double update_protected_set(struct protected_set *ps);
+
+/*
+ * Release the resources used by the set
+ */
+void close_protected_set(struct protected_set *ps);
+
+#endif
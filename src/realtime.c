@@ -0,0 +1,83 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include "realtime.h"
+
+//stack touched in advance by lock_memory() (in bytes)
+#define PREFAULT_STACK (256 * 1024)
+
+static void prefault_stack()
+{
+	volatile char stack[PREFAULT_STACK];
+	memset((char*)stack, 0, sizeof(stack));
+}
+
+int lock_memory()
+{
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) return -1;
+	prefault_stack();
+	return 0;
+}
+
+int set_timer_slack(unsigned long ns)
+{
+#ifdef PR_SET_TIMERSLACK
+	return prctl(PR_SET_TIMERSLACK, ns, 0, 0, 0) == 0 ? 0 : -1;
+#else
+	return -1;
+#endif
+}
+
+int set_thread_realtime(pthread_t thread, int priority)
+{
+	struct sched_param param;
+	param.sched_priority = priority;
+	return pthread_setschedparam(thread, priority > 0 ? SCHED_FIFO : SCHED_OTHER, &param) == 0 ? 0 : -1;
+}
+
+int pin_thread(pthread_t thread, int cpu)
+{
+#ifdef __linux__
+	cpu_set_t mask;
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	return pthread_setaffinity_np(thread, sizeof(mask), &mask) == 0 ? 0 : -1;
+#else
+	return -1;
+#endif
+}
+
+double get_thread_cputime(pthread_t thread)
+{
+	clockid_t clock;
+	struct timespec t;
+	if (pthread_getcpuclockid(thread, &clock) != 0 || clock_gettime(clock, &t) != 0) return -1;
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
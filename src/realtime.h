@@ -0,0 +1,61 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef __REALTIME_H
+
+#define __REALTIME_H
+
+#include <pthread.h>
+
+/*
+ * Lock all the memory of cpulimit, present and future, and touch the
+ * stack so that the control loop never waits for a page fault
+ * return 0 on success, -1 on error
+ */
+int lock_memory();
+
+/*
+ * Set the timer slack of the calling thread, inherited by the threads it
+ * creates afterwards (in nanoseconds)
+ * return 0 on success, -1 if not supported
+ */
+int set_timer_slack(unsigned long ns);
+
+/*
+ * Run the thread with the SCHED_FIFO policy at the given priority, or
+ * with the normal policy if priority is 0
+ * return 0 on success, -1 on error
+ */
+int set_thread_realtime(pthread_t thread, int priority);
+
+/*
+ * Let the thread run only on the given cpu
+ * return 0 on success, -1 on error
+ */
+int pin_thread(pthread_t thread, int cpu);
+
+/*
+ * Cpu time used by the thread so far (in seconds), or -1 on error
+ */
+double get_thread_cputime(pthread_t thread);
+
+#endif
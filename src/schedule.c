@@ -0,0 +1,53 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "schedule.h"
+
+int parse_schedule_entry(const char *arg, struct schedule_entry *entry)
+{
+	int h1, m1, h2, m2, perc, n;
+	if (sscanf(arg, "%d:%d-%d:%d=%d%n", &h1, &m1, &h2, &m2, &perc, &n) != 5 || arg[n] != '\0')
+		return -1;
+	if (h1 < 0 || h1 > 24 || h2 < 0 || h2 > 24 || m1 < 0 || m1 > 59 || m2 < 0 || m2 > 59 || perc < 0
+		|| (h1 == 24 && m1 > 0) || (h2 == 24 && m2 > 0))
+		return -1;
+	entry->start = (h1 * 60 + m1) % (24 * 60);
+	entry->end = (h2 * 60 + m2) % (24 * 60);
+	entry->limit = perc / 100.0;
+	return 0;
+}
+
+double get_scheduled_limit(const struct schedule_entry *entries, int count, time_t t)
+{
+	struct tm tm;
+	int i;
+	localtime_r(&t, &tm);
+	int minute = tm.tm_hour * 60 + tm.tm_min;
+	for (i=0; i<count; i++) {
+		const struct schedule_entry *e = &entries[i];
+		if (e->start < e->end ? (minute >= e->start && minute < e->end) : (minute >= e->start || minute < e->end))
+			return e->limit;
+	}
+	return -1;
+}
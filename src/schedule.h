@@ -0,0 +1,52 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __SCHEDULE_H
+
+#define __SCHEDULE_H
+
+#include <time.h>
+
+#define MAX_SCHEDULE_ENTRIES 32
+
+// a limit applied in a range of the day
+struct schedule_entry {
+	//beginning and end of the range (minutes from midnight, local time)
+	//the range wraps around midnight if end <= start
+	int start;
+	int end;
+	//limit in the range (range 0-NCPU)
+	double limit;
+};
+
+/*
+ * Parse an entry in the form HH:MM-HH:MM=N, where N is a percentage
+ * return 0 on success, -1 if the entry is not valid
+ */
+int parse_schedule_entry(const char *arg, struct schedule_entry *entry);
+
+/*
+ * Return the limit of the first entry whose range contains the local time t
+ * or -1 if no entry contains it
+ */
+double get_scheduled_limit(const struct schedule_entry *entries, int count, time_t t);
+
+#endif
@@ -0,0 +1,163 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "share.h"
+
+#ifndef MAX
+#define MAX(a,b) (((a)>(b))?(a):(b))
+#endif
+
+//minimum share of a member, so that its demand can still be measured
+#define MIN_SHARE 0.01
+
+int parse_share_rule(const char *arg, struct share_rule *rule)
+{
+	const char *value = strchr(arg, '=');
+	const char *weight = strrchr(arg, ':');
+	char *end;
+	if (value == NULL || weight == NULL || weight < value) return -1;
+	value++;
+	rule->weight = strtod(weight + 1, &end);
+	if (*end != '\0' || weight[1] == '\0' || rule->weight < 0 || rule->weight > 100) return -1;
+	if (strncmp(arg, "pid=", 4) == 0) rule->type = SHARE_BY_PID;
+	else if (strncmp(arg, "name=", 5) == 0) rule->type = SHARE_BY_NAME;
+	else if (strncmp(arg, "depth=", 6) == 0) rule->type = SHARE_BY_DEPTH;
+	else return -1;
+	if (weight - value > PATH_MAX || weight == value) return -1;
+	memcpy(rule->name, value, weight - value);
+	rule->name[weight - value] = '\0';
+	if (rule->type != SHARE_BY_NAME) {
+		rule->value = strtol(rule->name, &end, 10);
+		if (*end != '\0' || rule->value < 0) return -1;
+	}
+	return 0;
+}
+
+//index of the first rule selecting the process, or nrules if none does
+static int match_rule(struct process_group *pgroup, struct process *p, struct share_rule *rules, int nrules)
+{
+	int i;
+	int depth = -2;
+	//the name of the executable, without the path
+	const char *name = strrchr(p->command, '/');
+	name = name != NULL ? name + 1 : p->command;
+	for (i=0; i<nrules; i++) {
+		switch (rules[i].type) {
+			case SHARE_BY_PID:
+				if (p->pid == rules[i].value) return i;
+				break;
+			case SHARE_BY_NAME:
+				if (strncmp(name, rules[i].name, strlen(rules[i].name)) == 0) return i;
+				break;
+			case SHARE_BY_DEPTH:
+				if (depth == -2) depth = get_process_depth(pgroup, p);
+				if (depth == rules[i].value) return i;
+				break;
+		}
+	}
+	return nrules;
+}
+
+struct member_share {
+	struct process *proc;
+	//weight of the member
+	double weight;
+	//usage the member would have if never stopped
+	double demand;
+	//budget assigned to the member
+	double budget;
+};
+
+//members with the lowest demand per weight first
+static int compare_members(const void *a, const void *b)
+{
+	const struct member_share *m1 = (const struct member_share*)a;
+	const struct member_share *m2 = (const struct member_share*)b;
+	//compare m1->demand/m1->weight and m2->demand/m2->weight without dividing by 0
+	double d = m1->demand * m2->weight - m2->demand * m1->weight;
+	return d < 0 ? -1 : (d > 0 ? 1 : 0);
+}
+
+void update_shares(struct process_group *pgroup, struct share_rule *rules, int nrules, double limit)
+{
+	struct list_node *node;
+	int n = pgroup->proclist->count;
+	int i;
+	if (n == 0) return;
+	struct member_share *members = (struct member_share*)malloc(n * sizeof(struct member_share));
+	int *rule_of = (int*)malloc(n * sizeof(int));
+	int *class_count = (int*)calloc(nrules + 1, sizeof(int));
+	if (members == NULL || rule_of == NULL || class_count == NULL) exit(2);
+
+	//assign every member to a class
+	for (node = pgroup->proclist->first, i = 0; node != NULL; node = node->next, i++) {
+		members[i].proc = (struct process*)(node->data);
+		rule_of[i] = match_rule(pgroup, members[i].proc, rules, nrules);
+		class_count[rule_of[i]]++;
+	}
+	//the default class gets what is left by the rules
+	double rest = 100;
+	for (i=0; i<nrules; i++) rest -= rules[i].weight;
+	rest = MAX(rest, 0);
+
+	//members whose demand is still unknown are not limited by the shares
+	int known = 0;
+	for (i=0; i<n; i++) {
+		struct process *p = members[i].proc;
+		p->share = 1;
+		if (p->cpu_usage < 0 || p->workingrate <= 0) continue;
+		members[known].proc = p;
+		members[known].weight = (rule_of[i] < nrules ? rules[rule_of[i]].weight : rest) / class_count[rule_of[i]];
+		members[known].demand = p->cpu_usage / p->workingrate;
+		known++;
+	}
+
+	//water-filling: satisfy the members demanding less than their fair
+	//part, and split what is left among the others by weight
+	qsort(members, known, sizeof(struct member_share), compare_members);
+	double left = limit;
+	double total_weight = 0;
+	for (i=0; i<known; i++) total_weight += members[i].weight;
+	for (i=0; i<known; i++) {
+		double fair = total_weight > 0 ? left * members[i].weight / total_weight : left / (known - i);
+		members[i].budget = members[i].demand < fair ? members[i].demand : fair;
+		left -= members[i].budget;
+		total_weight -= members[i].weight;
+	}
+
+	//the working slice of every member must be proportional to budget/demand
+	double max_ratio = 0;
+	for (i=0; i<known; i++) {
+		double ratio = members[i].demand > 0 ? members[i].budget / members[i].demand : 1;
+		members[i].proc->share = ratio;
+		max_ratio = MAX(max_ratio, ratio);
+	}
+	for (i=0; i<known; i++) {
+		members[i].proc->share = max_ratio > 0 ? MAX(members[i].proc->share / max_ratio, MIN_SHARE) : 1;
+	}
+	free(members);
+	free(rule_of);
+	free(class_count);
+}
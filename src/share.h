@@ -0,0 +1,64 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __SHARE_H
+
+#define __SHARE_H
+
+#include "process_group.h"
+
+#define MAX_SHARE_RULES 16
+
+//how a rule selects the members of the group
+#define SHARE_BY_PID 0
+#define SHARE_BY_NAME 1
+#define SHARE_BY_DEPTH 2
+
+// a class of members receiving a percentage of the group budget
+struct share_rule {
+	//one of SHARE_BY_*
+	int type;
+	//selected pid (SHARE_BY_PID) or depth in the tree (SHARE_BY_DEPTH)
+	int value;
+	//name of the executable (SHARE_BY_NAME)
+	char name[PATH_MAX+1];
+	//percentage of the group budget (range 0-100)
+	double weight;
+};
+
+/*
+ * Parse a rule in the form pid=N:W, name=FILE:W or depth=N:W
+ * return 0 on success, -1 if the rule is not valid
+ */
+int parse_share_rule(const char *arg, struct share_rule *rule);
+
+/*
+ * Split the group budget (limit) among the members according to the rules
+ * each rule gives its weight to the members it selects (first match wins),
+ * the members not selected by any rule share what is left up to 100
+ * the budget of a member is then reduced to what it actually demands and
+ * the excess is redistributed among the others (weighted max-min fairness)
+ * on return proc->share holds the fraction of the group working slice
+ * that each member needs to get its budget
+ */
+void update_shares(struct process_group *pgroup, struct share_rule *rules, int nrules, double limit);
+
+#endif
@@ -0,0 +1,125 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#include <signal.h>
+
+#include "slot.h"
+
+void init_slot_plan(struct slot_plan *plan, long length)
+{
+	plan->length = length;
+	plan->edges = NULL;
+	plan->count = 0;
+	plan->size = 0;
+}
+
+void clear_slot_plan(struct slot_plan *plan, long length)
+{
+	plan->length = length;
+	plan->count = 0;
+}
+
+static void add_edge(struct slot_plan *plan, struct process *proc, long offset, int sig)
+{
+	if (plan->count == plan->size) {
+		plan->size = plan->size == 0 ? 16 : plan->size * 2;
+		plan->edges = (struct slot_edge*)realloc(plan->edges, plan->size * sizeof(struct slot_edge));
+		if (plan->edges == NULL) exit(2);
+	}
+	plan->edges[plan->count].offset = offset;
+	plan->edges[plan->count].sig = sig;
+	plan->edges[plan->count].proc = proc;
+	plan->edges[plan->count].pgid = 0;
+	plan->count++;
+}
+
+void add_work_window(struct slot_plan *plan, struct process *proc, long start, long len)
+{
+	start %= plan->length;
+	if (len <= 0) {
+		add_edge(plan, proc, 0, SIGSTOP);
+		return;
+	}
+	add_edge(plan, proc, start, SIGCONT);
+	if (len < plan->length) {
+		add_edge(plan, proc, (start + len) % plan->length, SIGSTOP);
+	}
+}
+
+long dither_slot(long length, double dither, unsigned int *seed, double *position)
+{
+	if (dither <= 0) {
+		*position = 0;
+		return length;
+	}
+	double u = (double)rand_r(seed) / RAND_MAX;
+	*position = (double)rand_r(seed) / RAND_MAX;
+	return length * (1 + dither * (2 * u - 1));
+}
+
+static int compare_edges(const void *a, const void *b)
+{
+	const struct slot_edge *e1 = (const struct slot_edge*)a;
+	const struct slot_edge *e2 = (const struct slot_edge*)b;
+	if (e1->offset != e2->offset) return e1->offset < e2->offset ? -1 : 1;
+	if (e1->sig != e2->sig) return e1->sig == SIGSTOP ? -1 : 1;
+	//keep the members of a process group together, to batch them
+	if (e1->proc->pgid != e2->proc->pgid) return e1->proc->pgid < e2->proc->pgid ? -1 : 1;
+	return 0;
+}
+
+void sort_slot_plan(struct slot_plan *plan)
+{
+	qsort(plan->edges, plan->count, sizeof(struct slot_edge), compare_edges);
+}
+
+int batch_slot_plan(struct slot_plan *plan)
+{
+	int i = 0, j, n = 0;
+	while (i < plan->count) {
+		struct slot_edge *first = &plan->edges[i];
+		//edges sending the same signal at the same time to a process group
+		for (j=i+1; j<plan->count; j++) {
+			struct slot_edge *edge = &plan->edges[j];
+			if (edge->offset != first->offset || edge->sig != first->sig || edge->proc->pgid != first->proc->pgid) break;
+		}
+		if (first->proc->pgid_members > 1 && j - i == first->proc->pgid_members) {
+			plan->edges[n] = *first;
+			plan->edges[n++].pgid = first->proc->pgid;
+		}
+		else {
+			for (; i<j; i++) plan->edges[n++] = plan->edges[i];
+		}
+		i = j;
+	}
+	i = plan->count - n;
+	plan->count = n;
+	return i;
+}
+
+void close_slot_plan(struct slot_plan *plan)
+{
+	free(plan->edges);
+	plan->edges = NULL;
+	plan->count = 0;
+	plan->size = 0;
+}
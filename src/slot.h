@@ -0,0 +1,101 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __SLOT_H
+
+#define __SLOT_H
+
+#include "process_iterator.h"
+
+// a signal sent to a member at a given time of the control slot
+struct slot_edge {
+	//offset from the beginning of the slot (in microseconds)
+	long offset;
+	//signal to send (SIGCONT or SIGSTOP)
+	int sig;
+	//member of the group receiving the signal
+	struct process *proc;
+	//if not 0, the signal is sent to this whole process group instead,
+	//proc being one of its members
+	pid_t pgid;
+};
+
+// the sequence of signals to send during a control slot
+struct slot_plan {
+	//length of the slot (in microseconds)
+	long length;
+	//edges, sorted by offset after sort_slot_plan()
+	struct slot_edge *edges;
+	//number of edges in the plan
+	int count;
+	//number of edges allocated
+	int size;
+};
+
+/*
+ * Initialize an empty plan for a slot of the given length
+ */
+void init_slot_plan(struct slot_plan *plan, long length);
+
+/*
+ * Remove all the edges from the plan, and set the new slot length
+ */
+void clear_slot_plan(struct slot_plan *plan, long length);
+
+/*
+ * Add the working window [start, start+len) of a member to the plan
+ * the window wraps around the end of the slot
+ * if len covers the whole slot the member is never stopped
+ * if len is 0 the member is never resumed
+ */
+void add_work_window(struct slot_plan *plan, struct process *proc, long start, long len);
+
+/*
+ * Pick the length of the next slot, uniformly within dither*length of the
+ * nominal length (dither range 0-1), and the position of the work windows
+ * in it, as a fraction of the time left free by the windows (range 0-1)
+ * the slots are as long as the nominal one on average, so the duty cycle
+ * is kept if the working slice is proportional to the slot length
+ * seed is the state of the pseudo-random generator (see rand_r())
+ * with dither 0 return length, and position 0
+ */
+long dither_slot(long length, double dither, unsigned int *seed, double *position);
+
+/*
+ * Sort the edges of the plan by offset
+ * SIGSTOP is sent before SIGCONT when they have the same offset
+ */
+void sort_slot_plan(struct slot_plan *plan);
+
+/*
+ * Merge the edges of a sorted plan sending the same signal at the same time
+ * to all the members of a process group (see pgid_members) into one edge
+ * for the whole process group
+ * return the number of edges removed
+ */
+int batch_slot_plan(struct slot_plan *plan);
+
+/*
+ * Free the memory used by the plan
+ */
+void close_slot_plan(struct slot_plan *plan);
+
+#endif
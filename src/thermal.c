@@ -0,0 +1,78 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "thermal.h"
+
+//smoothing factor of the temperature (range 0-1)
+#define THERMAL_ALFA 0.3
+
+//read the temperature (in degrees Celsius)
+static int read_temperature(int fd, double *temperature)
+{
+	char buffer[32];
+	char *end;
+	//the file is read again from the beginning at every sample
+	ssize_t n = pread(fd, buffer, sizeof(buffer) - 1, 0);
+	if (n <= 0) return -1;
+	buffer[n] = '\0';
+	long millidegrees = strtol(buffer, &end, 10);
+	if (end == buffer) return -1;
+	*temperature = millidegrees / 1000.0;
+	return 0;
+}
+
+int init_thermal_zone(struct thermal_zone *z, const char *path)
+{
+	z->fd = open(path, O_RDONLY);
+	if (z->fd < 0) return -1;
+	if (read_temperature(z->fd, &z->temperature) != 0) {
+		close(z->fd);
+		z->fd = -1;
+		return -1;
+	}
+	return 0;
+}
+
+int update_thermal_zone(struct thermal_zone *z)
+{
+	double sample;
+	if (read_temperature(z->fd, &sample) != 0) return -1;
+	z->temperature = (1 - THERMAL_ALFA) * z->temperature + THERMAL_ALFA * sample;
+	return 0;
+}
+
+void close_thermal_zone(struct thermal_zone *z)
+{
+	if (z->fd >= 0) close(z->fd);
+	z->fd = -1;
+}
+
+double get_thermal_factor(double temperature, double threshold)
+{
+	double factor = (threshold - temperature) / THERMAL_BAND;
+	if (factor > 1) return 1;
+	if (factor < THERMAL_MIN_FACTOR) return THERMAL_MIN_FACTOR;
+	return factor;
+}
@@ -0,0 +1,61 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __THERMAL_H
+
+#define __THERMAL_H
+
+//the limit is tightened from THERMAL_BAND degrees below the threshold
+#define THERMAL_BAND 10
+//lowest fraction of the limit allowed, at the threshold and above
+#define THERMAL_MIN_FACTOR 0.1
+
+// sampler of a thermal zone, a file holding a temperature in millidegrees
+// Celsius as in /sys/class/thermal/thermal_zone*/temp
+struct thermal_zone {
+	//file descriptor to read the temperature
+	int fd;
+	//temperature, smoothed (in degrees Celsius)
+	double temperature;
+};
+
+/*
+ * Open the thermal zone file and take the first sample
+ * return 0 on success, -1 if the temperature can't be read
+ */
+int init_thermal_zone(struct thermal_zone *z, const char *path);
+
+/*
+ * Take a new sample, stored in z->temperature
+ * return 0 on success, -1 on error
+ */
+int update_thermal_zone(struct thermal_zone *z);
+
+void close_thermal_zone(struct thermal_zone *z);
+
+/*
+ * Fraction of the limit allowed at a temperature (range THERMAL_MIN_FACTOR-1)
+ * 1 up to THERMAL_BAND degrees below the threshold, then decreasing
+ * linearly towards 0 at the threshold, but never below THERMAL_MIN_FACTOR
+ */
+double get_thermal_factor(double temperature, double threshold);
+
+#endif
@@ -0,0 +1,117 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <sys/stat.h>
+
+#include <capacity.h>
+#include <cgroup.h>
+
+#include "fixture.h"
+
+void test_cpu_list()
+{
+	assert(count_cpu_list("0") == 1);
+	assert(count_cpu_list("0-3\n") == 4);
+	assert(count_cpu_list("0-3,8,10-11") == 7);
+	assert(count_cpu_list("") == 0);
+	assert(count_cpu_list("3-1") == -1);
+	assert(count_cpu_list("0-3;8") == -1);
+	assert(count_cpu_list("a") == -1);
+}
+
+void test_cgroup_tree()
+{
+	char root[] = "/tmp/capacity_test_XXXXXX";
+	char dir[1024];
+	assert(mkdtemp(root) != NULL);
+	//the root of the hierarchy has no quota
+	sprintf(dir, "%s/a", root);
+	assert(mkdir(dir, 0755) == 0);
+	write_file(dir, "cpu.max", "400000 100000\n");
+	sprintf(dir, "%s/a/b", root);
+	assert(mkdir(dir, 0755) == 0);
+	write_file(dir, "cpu.max", "max 100000\n");
+	write_file(dir, "cpuset.cpus.effective", "0-3,8,10-11\n");
+	sprintf(dir, "%s/a/b/c", root);
+	assert(mkdir(dir, 0755) == 0);
+	write_file(dir, "cpu.max", "150000 100000\n");
+	assert(get_cgroup_quota(root, "", NULL) == -1);
+	assert(get_cgroup_quota(root, "/a", NULL) == 4);
+	//no quota of its own, but the one of the parent applies
+	assert(get_cgroup_quota(root, "/a/b", NULL) == 4);
+	assert(get_cgroup_quota(root, "/a/b/c", NULL) == 1.5);
+	//the quota can change at any time
+	write_file(dir, "cpu.max", "max 100000\n");
+	assert(get_cgroup_quota(root, "/a/b/c", NULL) == 4);
+	assert(get_cgroup_cpuset(root, "/a/b") == 7);
+	assert(get_cgroup_cpuset(root, "/a") == -1);
+	assert(get_cgroup_quota(root, "/missing", NULL) == -1);
+	sprintf(dir, "rm -rf %s", root);
+	assert(system(dir) == 0);
+}
+
+void test_process_capacity()
+{
+	double capacity = get_cpu_capacity(0, NULL);
+	assert(capacity > 0 && capacity <= get_online_cpus());
+	assert(get_cpu_capacity(getpid(), NULL) == capacity);
+#ifdef __linux__
+	assert(get_cpu_capacity(9999999, NULL) == -1);
+#endif
+}
+
+void test_limiter_quota()
+{
+	char root[] = "/tmp/capacity_test_XXXXXX";
+	char dir[1024];
+	struct cpu_cgroup cg;
+	assert(mkdtemp(root) != NULL);
+	sprintf(dir, "%s/a", root);
+	assert(mkdir(dir, 0755) == 0);
+	write_file(dir, "cpu.max", "400000 100000\n");
+	sprintf(dir, "%s/a/job", root);
+	assert(mkdir(dir, 0755) == 0);
+	write_file(dir, "cpu.max", "max 100000\n");
+	//the limiter writes its target to the cgroup of the processes
+	assert(open_cgroup(&cg, dir, 100000) == 0);
+	assert(set_cgroup_limit(&cg, 0.3) == 0);
+	assert(get_cgroup_quota(root, "/a/job", NULL) == 0.3);
+	//but the capacity only comes from the quota of the ancestors
+	assert(get_cgroup_quota(root, "/a/job", cg.path) == 4);
+	sprintf(dir, "%s/a/./job/", root);
+	assert(get_cgroup_quota(root, "/a/job", dir) == 4);
+	sprintf(dir, "rm -rf %s", root);
+	assert(system(dir) == 0);
+}
+
+int main(int argc, char **argv)
+{
+	test_cpu_list();
+	test_cgroup_tree();
+	test_process_capacity();
+	test_limiter_quota();
+	return 0;
+}
@@ -0,0 +1,182 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <cgroup.h>
+
+#include "fixture.h"
+
+void test_leaf(const char *root)
+{
+	struct cpu_cgroup cg;
+	char dir[1024], pid[32];
+	sprintf(dir, "%s/job", root);
+	assert(mkdir(dir, 0755) == 0);
+	write_file(dir, "cpu.max", "max 100000\n");
+	write_file(dir, "cgroup.procs", "");
+	//the cgroup is reused
+	assert(open_cgroup(&cg, dir, 100000) == 0);
+	assert(cg.created == 0);
+	//never move the test back in the real hierarchy
+	strcpy(cg.root, root);
+	assert(move_to_cgroup(&cg, getpid()) == 0);
+	sprintf(pid, "%d\n", getpid());
+	check_file(dir, "cgroup.procs", pid);
+	assert(set_cgroup_limit(&cg, 0.5) == 0);
+	check_file(dir, "cpu.max", "50000 100000\n");
+	//the same quota is not written again
+	write_file(dir, "cpu.max", "");
+	assert(set_cgroup_limit(&cg, 0.5) == 0);
+	check_file(dir, "cpu.max", "");
+	assert(set_cgroup_limit(&cg, 2.5) == 0);
+	check_file(dir, "cpu.max", "250000 100000\n");
+	assert(set_cgroup_limit(&cg, 0) == 0);
+	check_file(dir, "cpu.max", "1000 100000\n");
+	//the limit is removed when closing, and a reused cgroup stays
+	close_cgroup(&cg);
+	check_file(dir, "cpu.max", "max 100000\n");
+	assert(access(dir, F_OK) == 0);
+}
+
+void test_missing_controller(const char *root)
+{
+	struct cpu_cgroup cg;
+	char dir[1024];
+	//a new cgroup without cpu.max: the cpu controller is enabled in the
+	//parent, but it is still missing since nothing creates the files
+	write_file(root, "cgroup.subtree_control", "");
+	sprintf(dir, "%s/new", root);
+	assert(open_cgroup(&cg, dir, 100000) != 0);
+	check_file(root, "cgroup.subtree_control", "+cpu");
+	//and the cgroup created is removed
+	assert(access(dir, F_OK) != 0);
+	sprintf(dir, "%s/missing/new", root);
+	assert(open_cgroup(&cg, dir, 100000) != 0);
+}
+
+void test_freezer(const char *root)
+{
+	struct cpu_cgroup cg;
+	char dir[1024];
+	sprintf(dir, "%s/frozen", root);
+	assert(mkdir(dir, 0755) == 0);
+	//no cgroup.freeze before Linux 5.2
+	write_file(dir, "cgroup.events", "populated 1\nfrozen 0\n");
+	assert(open_cgroup_freezer(&cg, dir) != 0);
+	write_file(dir, "cgroup.freeze", "0\n");
+	//no cpu.max is needed
+	assert(open_cgroup_freezer(&cg, dir) == 0);
+	assert(is_cgroup_frozen(&cg) == 0);
+	assert(freeze_cgroup(&cg, 1) == 0);
+	check_file(dir, "cgroup.freeze", "1\n");
+	//the kernel reports when all the processes are frozen
+	write_file(dir, "cgroup.events", "populated 1\nfrozen 1\n");
+	assert(is_cgroup_frozen(&cg) == 1);
+	assert(freeze_cgroup(&cg, 0) == 0);
+	check_file(dir, "cgroup.freeze", "0\n");
+	write_file(dir, "cgroup.events", "populated 1\n");
+	assert(is_cgroup_frozen(&cg) == -1);
+	//the processes are thawed when closing
+	assert(freeze_cgroup(&cg, 1) == 0);
+	close_cgroup(&cg);
+	check_file(dir, "cgroup.freeze", "0\n");
+	assert(access(dir, F_OK) == 0);
+}
+
+void test_restore(const char *root)
+{
+	struct cpu_cgroup cg;
+	char dir[1024], origin[1024], path[1024], command[2100], pid[32], procs[64];
+	//the cgroup the test runs in, in the directory standing in for cgroupfs
+	if (find_process_cgroup(0, path, sizeof(path)) != 0) return;
+	sprintf(origin, "%s%s", root, path);
+	sprintf(command, "mkdir -p %s", origin);
+	assert(system(command) == 0);
+	write_file(origin, "cgroup.procs", "");
+	sprintf(dir, "%s/moved", root);
+	assert(mkdir(dir, 0755) == 0);
+	write_file(dir, "cpu.max", "max 100000\n");
+	write_file(dir, "cgroup.procs", "");
+	assert(open_cgroup(&cg, dir, 100000) == 0);
+	strcpy(cg.root, root);
+	assert(move_to_cgroup(&cg, getpid()) == 0);
+	assert(cg.origins_count == 1 && strcmp(cg.origins[0], path) == 0);
+	assert(cg.moves_count == 1 && cg.moves[0].pid == getpid());
+	//the process is moved back
+	sprintf(pid, "%d\n", getpid());
+	write_file(dir, "cgroup.procs", pid);
+	close_cgroup(&cg);
+	check_file(origin, "cgroup.procs", pid);
+	assert(cg.origins_count == 0 && cg.moves_count == 0);
+	//a child forked in the cgroup goes where its parent was, but a
+	//process of the reused cgroup never moved (the parent of the test)
+	//stays there: it would be the last one written
+	pid_t child = fork();
+	assert(child >= 0);
+	if (child == 0) {
+		pause();
+		_exit(0);
+	}
+	write_file(origin, "cgroup.procs", "");
+	assert(open_cgroup(&cg, dir, 100000) == 0);
+	strcpy(cg.root, root);
+	assert(move_to_cgroup(&cg, getpid()) == 0);
+	sprintf(procs, "%d\n%d\n", child, getppid());
+	write_file(dir, "cgroup.procs", procs);
+	close_cgroup(&cg);
+	sprintf(pid, "%d\n", child);
+	check_file(origin, "cgroup.procs", pid);
+	kill(child, SIGKILL);
+	waitpid(child, NULL, 0);
+	//with no process moved, nothing is moved back
+	write_file(origin, "cgroup.procs", "");
+	assert(open_cgroup(&cg, dir, 100000) == 0);
+	strcpy(cg.root, root);
+	sprintf(pid, "%d\n", getppid());
+	write_file(dir, "cgroup.procs", pid);
+	assert(is_cgroup_populated(dir) == 1);
+	close_cgroup(&cg);
+	check_file(origin, "cgroup.procs", "");
+	write_file(dir, "cgroup.procs", "");
+	assert(is_cgroup_populated(dir) == 0);
+}
+
+int main(int argc, char **argv)
+{
+	char root[] = "/tmp/cgroup_test_XXXXXX";
+	char command[64];
+	assert(mkdtemp(root) != NULL);
+	test_leaf(root);
+	test_missing_controller(root);
+	test_freezer(root);
+	test_restore(root);
+	sprintf(command, "rm -rf %s", root);
+	assert(system(command) == 0);
+	return 0;
+}
@@ -0,0 +1,194 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <controller.h>
+
+//must match the smoothing factor used by update_process_group()
+#define ALFA 0.08
+//number of control cycles simulated after the step
+#define CYCLES 600
+//band around the limit in which the usage is considered settled
+#define BAND 0.05
+
+struct step_response {
+	//cycles needed to stay within BAND of the limit
+	int settling_time;
+	//peak deviation on the other side of the limit after the first
+	//crossing, relative to the limit
+	double overshoot;
+	//usage at the end of the simulation
+	double final_usage;
+};
+
+//simulate a group whose cpu demand jumps from demand0 to demand1 at cycle 0
+//the plant uses workingrate*demand cpu in each slot, and the controller sees
+//the same exponentially smoothed estimate that update_process_group() produces
+static void simulate(int type, double limit, double demand0, double demand1, struct step_response *r)
+{
+	struct controller ctl;
+	int i;
+	init_controller(&ctl, type, limit);
+	double pcpu = -1;
+	double usage = 0;
+	//settle on the initial demand
+	for (i=0; i<CYCLES; i++) {
+		usage = ctl.workingrate * demand0;
+		pcpu = pcpu < 0 ? usage : (1-ALFA) * pcpu + ALFA * usage;
+		controller_update(&ctl, pcpu, limit);
+	}
+	r->settling_time = 0;
+	r->overshoot = 0;
+	//sign of the initial error, the overshoot is measured once it flips
+	int side = ctl.workingrate * demand1 > limit ? 1 : -1;
+	int crossed = 0;
+	for (i=0; i<CYCLES; i++) {
+		usage = ctl.workingrate * demand1;
+		if ((usage - limit) * side < 0)
+			crossed = 1;
+		if (crossed && (limit - usage) * side > r->overshoot * limit)
+			r->overshoot = (limit - usage) * side / limit;
+		if (usage > limit * (1+BAND) || usage < limit * (1-BAND))
+			r->settling_time = i + 1;
+		pcpu = (1-ALFA) * pcpu + ALFA * usage;
+		controller_update(&ctl, pcpu, limit);
+	}
+	r->final_usage = usage;
+}
+
+//simulate attaching to a group that was running freely with the given demand
+//cold: the controller starts from the limit
+//warm: the demand has been calibrated, the controller starts from the working
+//rate that meets the limit
+//in both cases the usage estimate starts from the first slot
+//return the cycles needed to stay within BAND of the limit
+static int simulate_attach(int type, double limit, double demand, int warm)
+{
+	struct controller ctl;
+	int i;
+	int settling_time = 0;
+	init_controller(&ctl, type, limit);
+	if (warm) warm_start_controller(&ctl, limit / demand);
+	double pcpu = -1;
+	for (i=0; i<CYCLES; i++) {
+		double usage = ctl.workingrate * demand;
+		if (usage > limit * (1+BAND) || usage < limit * (1-BAND))
+			settling_time = i + 1;
+		pcpu = pcpu < 0 ? usage : (1-ALFA) * pcpu + ALFA * usage;
+		controller_update(&ctl, pcpu, limit);
+	}
+	return settling_time;
+}
+
+static void report(const char *name, struct step_response *r)
+{
+	printf("  %-5s settling time %4d cycles, overshoot %5.1f%%, final usage %0.3f\n",
+		name, r->settling_time, r->overshoot * 100, r->final_usage);
+}
+
+void test_controller_names()
+{
+	assert(controller_type_by_name("mult") == CONTROLLER_MULTIPLICATIVE);
+	assert(controller_type_by_name("pi") == CONTROLLER_PI);
+	assert(controller_type_by_name("foo") == -1);
+}
+
+void test_step_response(double limit, double demand0, double demand1)
+{
+	struct step_response mult, pi;
+	simulate(CONTROLLER_MULTIPLICATIVE, limit, demand0, demand1, &mult);
+	simulate(CONTROLLER_PI, limit, demand0, demand1, &pi);
+	printf("Step response: limit %0.2f, demand %0.2f -> %0.2f\n", limit, demand0, demand1);
+	report("mult", &mult);
+	report("pi", &pi);
+	//the PI controller must converge to the limit...
+	assert(pi.settling_time < CYCLES);
+	assert(pi.final_usage > limit * (1-BAND) && pi.final_usage < limit * (1+BAND));
+	//...and do it faster and with less overshoot than the old algorithm
+	assert(pi.settling_time <= mult.settling_time);
+	assert(pi.overshoot <= mult.overshoot + 0.01);
+}
+
+void test_warm_start(double limit, double demand)
+{
+	int cold_mult = simulate_attach(CONTROLLER_MULTIPLICATIVE, limit, demand, 0);
+	int warm_mult = simulate_attach(CONTROLLER_MULTIPLICATIVE, limit, demand, 1);
+	int cold_pi = simulate_attach(CONTROLLER_PI, limit, demand, 0);
+	int warm_pi = simulate_attach(CONTROLLER_PI, limit, demand, 1);
+	printf("Attach: limit %0.2f, demand %0.2f\n", limit, demand);
+	printf("  mult  settling time %4d cycles cold, %4d cycles warm\n", cold_mult, warm_mult);
+	printf("  pi    settling time %4d cycles cold, %4d cycles warm\n", cold_pi, warm_pi);
+	//a calibrated controller is within the band from the first cycle
+	assert(warm_mult == 0 && warm_mult <= cold_mult);
+	assert(warm_pi == 0 && warm_pi <= cold_pi);
+}
+
+//cycles the PI controller needs to settle after a long saturation, once the
+//demand goes above the limit
+static int recovery_time(double limit, double demand)
+{
+	struct controller ctl;
+	int i;
+	int settling_time = 0;
+	init_controller(&ctl, CONTROLLER_PI, limit);
+	//a long period well under the limit saturates the output
+	double pcpu = 0.05;
+	for (i=0; i<1000; i++)
+		controller_update(&ctl, pcpu, limit);
+	assert(ctl.workingrate == 1);
+	for (i=0; i<CYCLES; i++) {
+		double usage = ctl.workingrate * demand;
+		if (usage > limit * (1+BAND) || usage < limit * (1-BAND))
+			settling_time = i + 1;
+		pcpu = (1-ALFA) * pcpu + ALFA * usage;
+		controller_update(&ctl, pcpu, limit);
+	}
+	return settling_time;
+}
+
+void test_anti_windup()
+{
+	//while the output is saturated the integral term must not keep
+	//growing: wound up to its bound, it holds the working rate high for
+	//35-40 cycles once the demand exceeds the limit, instead of 7-13
+	int slight = recovery_time(0.5, 0.6);
+	int double_demand = recovery_time(0.3, 0.6);
+	printf("Recovery after saturation: %d cycles (limit 0.50, demand 0.60), %d cycles (limit 0.30, demand 0.60)\n", slight, double_demand);
+	assert(slight <= 20);
+	assert(double_demand <= 20);
+}
+
+int main(int argc, char **argv)
+{
+	test_controller_names();
+	test_step_response(0.5, 1.0, 4.0);
+	test_step_response(0.5, 4.0, 1.0);
+	test_step_response(1.0, 0.5, 2.0);
+	test_step_response(2.0, 8.0, 3.0);
+	test_warm_start(0.3, 1.0);
+	test_warm_start(0.5, 4.0);
+	test_warm_start(2.0, 3.0);
+	test_anti_windup();
+	return 0;
+}
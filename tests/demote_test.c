@@ -0,0 +1,84 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <assert.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include <demote.h>
+
+static int get_nice(pid_t pid)
+{
+	return getpriority(PRIO_PROCESS, pid);
+}
+
+void test_forked_from_demoted()
+{
+	struct process parent, child;
+	int nice = get_nice(0);
+	//the priorities can be given back only with the privilege to do so
+	if (can_restore_process(getpid()) != 1) {
+		printf("Skipping the demotion test, cannot restore the priorities\n");
+		return;
+	}
+	memset(&parent, 0, sizeof(parent));
+	parent.pid = getpid();
+	assert(demote_process(&parent, NULL) == 0);
+	assert(parent.demoted == 1);
+	//the child inherits the idle class
+	pid_t pid = fork();
+	assert(pid >= 0);
+	if (pid == 0) {
+		pause();
+		_exit(0);
+	}
+	memset(&child, 0, sizeof(child));
+	child.pid = pid;
+	child.ppid = getpid();
+	assert(demote_process(&child, &parent) == 0);
+	//but it is restored to the class the parent had before
+	assert(child.nice == nice);
+	assert(restore_process(&child) == 0);
+	assert(get_nice(pid) == nice);
+#ifdef __linux__
+	assert(child.policy == SCHED_OTHER);
+	assert(sched_getscheduler(pid) == SCHED_OTHER);
+#endif
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+	assert(restore_process(&parent) == 0);
+	assert(get_nice(0) == nice);
+}
+
+int main(int argc, char **argv)
+{
+	test_forked_from_demoted();
+	return 0;
+}
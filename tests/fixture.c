@@ -0,0 +1,49 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "fixture.h"
+
+void write_file(const char *dir, const char *name, const char *content)
+{
+	char path[1024];
+	sprintf(path, "%s/%s", dir, name);
+	FILE *fd = fopen(path, "w");
+	assert(fd != NULL);
+	fputs(content, fd);
+	fclose(fd);
+}
+
+void check_file(const char *dir, const char *name, const char *content)
+{
+	char path[1024], buffer[256];
+	sprintf(path, "%s/%s", dir, name);
+	FILE *fd = fopen(path, "r");
+	assert(fd != NULL);
+	size_t n = fread(buffer, 1, sizeof(buffer) - 1, fd);
+	fclose(fd);
+	buffer[n] = '\0';
+	assert(strcmp(buffer, content) == 0);
+}
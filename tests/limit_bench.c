@@ -0,0 +1,561 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+
+//benchmarks of cpulimit running against a synthetic family of processes
+//each benchmark compares the default behaviour with the option under test
+
+//length of a warm-up run, and the sampling step and window of the usage (in ms)
+#define WARMUP_TIME 6000
+#define WARMUP_STEP 100
+#define WARMUP_WINDOW 1000
+//distance from the limit within which the usage is considered settled (in cpus)
+#define WARMUP_BAND 0.05
+//time the usage must stay within the band to be considered settled (in ms)
+#define WARMUP_HOLD 1000
+
+//path of the cpulimit binary
+static char cpulimit_path[PATH_MAX+1];
+
+//fork a family of members busy processes, children of a common idle parent
+//if scattered, every member is in its own process group, so that they can't
+//be signalled at once, and it dies with the parent
+//the members start spinning only when all of them have been forked, so that
+//they don't slow down the creation of the others
+//return the pid of the parent
+static pid_t fork_family(int members, int scattered)
+{
+	int gate[2], ready[2];
+	char c = 0;
+	if (pipe(gate) != 0 || pipe(ready) != 0) {
+		perror("pipe");
+		exit(1);
+	}
+	fflush(stdout);
+	pid_t parent = fork();
+	if (parent == 0) {
+		int i;
+		setpgid(0, 0);
+		close(ready[0]);
+		for (i=0; i<members; i++) {
+			if (fork() == 0) {
+				if (scattered) {
+					setpgid(0, 0);
+					prctl(PR_SET_PDEATHSIG, SIGKILL);
+				}
+				close(gate[1]);
+				close(ready[1]);
+				//wait for the end of file, when the parent closes the gate
+				read(gate[0], &c, 1);
+				close(gate[0]);
+				while(1);
+			}
+		}
+		close(gate[0]);
+		close(gate[1]);
+		write(ready[1], &c, 1);
+		close(ready[1]);
+		while(1) pause();
+	}
+	close(gate[1]);
+	close(ready[1]);
+	read(ready[0], &c, 1);
+	close(ready[0]);
+	close(gate[0]);
+	return parent;
+}
+
+static pid_t spawn_family(int members)
+{
+	return fork_family(members, 0);
+}
+
+static pid_t spawn_scattered_family(int members)
+{
+	return fork_family(members, 1);
+}
+
+//kill the family started by spawn_family()
+static void kill_family(pid_t parent)
+{
+	kill(-parent, SIGKILL);
+	waitpid(parent, NULL, 0);
+}
+
+//run cpulimit against the family, with the given extra options (NULL terminated)
+//if output is not NULL, it gets the read end of a pipe from the standard
+//output of cpulimit
+static pid_t start_limiter(pid_t target, const char *limit, char **options, int *output)
+{
+	int fds[2];
+	if (output != NULL && pipe(fds) != 0) {
+		perror("pipe");
+		exit(1);
+	}
+	fflush(stdout);
+	pid_t limiter = fork();
+	if (limiter == 0) {
+		char *args[32];
+		char pid[16];
+		int n = 0;
+		sprintf(pid, "%d", target);
+		args[n++] = "cpulimit";
+		args[n++] = "-i";
+		args[n++] = "-l";
+		args[n++] = (char*)limit;
+		while (options != NULL && *options != NULL && n < 28) args[n++] = *options++;
+		args[n++] = "-p";
+		args[n++] = pid;
+		args[n] = NULL;
+		if (output != NULL) {
+			close(fds[0]);
+			dup2(fds[1], STDOUT_FILENO);
+			close(fds[1]);
+		}
+		else {
+			//keep quiet
+			freopen("/dev/null", "w", stdout);
+		}
+		execv(cpulimit_path, args);
+		perror("execv");
+		exit(1);
+	}
+	if (output != NULL) {
+		close(fds[1]);
+		*output = fds[0];
+	}
+	return limiter;
+}
+
+static void stop_limiter(pid_t limiter)
+{
+	kill(limiter, SIGTERM);
+	waitpid(limiter, NULL, 0);
+}
+
+static void sleep_ms(long ms)
+{
+	struct timespec t;
+	t.tv_sec = ms / 1000;
+	t.tv_nsec = (ms % 1000) * 1000000;
+	nanosleep(&t, NULL);
+}
+
+//number of runnable processes on the host, from /proc/stat
+static int get_procs_running()
+{
+	char line[256];
+	int running = -1;
+	FILE *fd = fopen("/proc/stat", "r");
+	if (fd == NULL) return -1;
+	while (fgets(line, sizeof(line), fd) != NULL) {
+		if (sscanf(line, "procs_running %d", &running) == 1) break;
+	}
+	fclose(fd);
+	return running;
+}
+
+//cpu time used by all the processes in the process group pgid (in seconds)
+static double get_family_cputime(pid_t pgid)
+{
+	double cputime = 0;
+	struct dirent *dit;
+	DIR *dip = opendir("/proc");
+	if (dip == NULL) return -1;
+	while ((dit = readdir(dip)) != NULL) {
+		char statfile[300], buffer[1024];
+		int pgrp;
+		unsigned long utime, stime;
+		if (dit->d_name[0] < '0' || dit->d_name[0] > '9') continue;
+		sprintf(statfile, "/proc/%s/stat", dit->d_name);
+		FILE *fd = fopen(statfile, "r");
+		if (fd == NULL) continue;
+		if (fgets(buffer, sizeof(buffer), fd) != NULL) {
+			//skip pid and command, which may contain spaces
+			char *p = strrchr(buffer, ')');
+			if (p != NULL && sscanf(p + 2, "%*c %*d %d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &pgrp, &utime, &stime) == 3 && pgrp == pgid)
+				cputime += (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+		}
+		fclose(fd);
+	}
+	closedir(dip);
+	return cputime;
+}
+
+//milliseconds elapsed since start
+static long elapsed_ms(const struct timespec *start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+//sample the host run-queue length every millisecond for the given time
+static void sample_runqueue(long ms, double *mean, double *variance)
+{
+	struct timespec start;
+	double sum = 0, sum2 = 0;
+	long n = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (elapsed_ms(&start) < ms) {
+		//don't count the sampler itself
+		int r = get_procs_running() - 1;
+		sum += r;
+		sum2 += (double)r * r;
+		n++;
+		sleep_ms(1);
+	}
+	*mean = sum / n;
+	*variance = sum2 / n - *mean * *mean;
+}
+
+//run-queue length of the host while limiting a family of busy processes,
+//with all the members stopped and resumed together or in staggered phases
+static void bench_runqueue(int members, const char *limit)
+{
+	char phases[16];
+	char *staggered[] = { "-s", phases, NULL };
+	double mean, variance, cputime;
+	int i;
+	sprintf(phases, "%d", members);
+	printf("Run-queue length, %d members limited to %s%%\n", members, limit);
+	for (i=0; i<2; i++) {
+		pid_t family = spawn_family(members);
+		pid_t limiter = start_limiter(family, limit, i == 0 ? NULL : staggered, NULL);
+		sleep_ms(2000);
+		cputime = get_family_cputime(family);
+		sample_runqueue(5000, &mean, &variance);
+		cputime = get_family_cputime(family) - cputime;
+		stop_limiter(limiter);
+		kill_family(family);
+		printf("  %-12s mean %6.2f variance %7.2f  group usage %6.2f%%\n", i == 0 ? "synchronized" : "staggered", mean, variance, cputime / 5 * 100);
+	}
+}
+
+//time needed by a busy process to get within WARMUP_BAND of the limit and
+//stay there for WARMUP_HOLD ms, since cpulimit was started (in ms, or -1 if
+//it never happens)
+//the usage is measured over a sliding window ending at the reported time
+static long measure_warmup(double limit, const char *perclimit, char **options)
+{
+	double cputime[WARMUP_TIME / WARMUP_STEP + 1];
+	int window = WARMUP_WINDOW / WARMUP_STEP;
+	int hold = WARMUP_HOLD / WARMUP_STEP;
+	int n = WARMUP_TIME / WARMUP_STEP + 1;
+	//first sample of the current run of windows within the band
+	int settled = -1;
+	struct timespec start;
+	int i;
+	pid_t family = spawn_family(1);
+	//let it run freely before attaching
+	sleep_ms(500);
+	pid_t limiter = start_limiter(family, perclimit, options, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i=0; i<n; i++) {
+		long wait = i * WARMUP_STEP - elapsed_ms(&start);
+		if (wait > 0) sleep_ms(wait);
+		cputime[i] = get_family_cputime(family);
+		if (i < window) continue;
+		double usage = (cputime[i] - cputime[i-window]) * 1000 / WARMUP_WINDOW;
+		if (usage > limit + WARMUP_BAND || usage < limit - WARMUP_BAND) {
+			settled = -1;
+		}
+		else {
+			if (settled < 0) settled = i;
+			if (i - settled >= hold) break;
+		}
+	}
+	stop_limiter(limiter);
+	kill_family(family);
+	return i < n ? settled * WARMUP_STEP : -1;
+}
+
+static void print_warmup(const char *name, long ms)
+{
+	if (ms < 0) printf("  %-12s not settled in %d ms\n", name, WARMUP_TIME);
+	else printf("  %-12s %5ld ms\n", name, ms);
+}
+
+//time to get within 5% of a cpu from the limit after attaching to a busy
+//process, calibrating at attach time or reading the demand from a state file
+static void bench_warmup(const char *perclimit)
+{
+	char state_file[] = "/tmp/limit_bench.XXXXXX";
+	char *with_state[] = { "-f", state_file, NULL };
+	double limit = atoi(perclimit) / 100.0;
+	int fd = mkstemp(state_file);
+	if (fd < 0) {
+		perror("mkstemp");
+		exit(1);
+	}
+	close(fd);
+	printf("Time to get within %d%% of the limit, busy process limited to %s%%\n", (int)(WARMUP_BAND * 100), perclimit);
+	print_warmup("calibrated", measure_warmup(limit, perclimit, NULL));
+	//the first run fills the state file, the second one uses it
+	measure_warmup(limit, perclimit, with_state);
+	print_warmup("state file", measure_warmup(limit, perclimit, with_state));
+	unlink(state_file);
+}
+
+//timing of the signals, from the verbose statistics of cpulimit
+struct edge_stats {
+	//number of statistics lines
+	int samples;
+	//average of the means and of the 99th percentiles (-1 if not reported),
+	//and the worst case (in microseconds)
+	double mean;
+	double p99;
+	long max;
+};
+
+//columns of the statistics, counting from the last one
+#define EDGE_ERROR_COLUMN 0
+#define STOP_SKEW_COLUMN 2
+
+//read the statistics printed by cpulimit every second, in the given column
+//they are either mean/p99/max or mean/max
+//skip the first ones while the controller settles
+static void read_edge_stats(int output, int column, struct edge_stats *stats)
+{
+	char line[256];
+	double mean;
+	long p99, max;
+	int skip = 2;
+	FILE *fd = fdopen(output, "r");
+	memset(stats, 0, sizeof(struct edge_stats));
+	while (fgets(line, sizeof(line), fd) != NULL) {
+		char *p = strrchr(line, '\t');
+		int i;
+		for (i=0; i<column && p != NULL; i++) {
+			*p = '\0';
+			p = strrchr(line, '\t');
+		}
+		if (p == NULL) continue;
+		int n = sscanf(p + 1, "%lf/%ld/%ld us", &mean, &p99, &max);
+		if (n == 2) {
+			max = p99;
+			p99 = -1;
+		}
+		else if (n != 3) continue;
+		if (skip-- > 0) continue;
+		stats->samples++;
+		stats->mean += mean;
+		stats->p99 += p99;
+		if (max > stats->max) stats->max = max;
+	}
+	fclose(fd);
+	if (stats->samples > 0) {
+		stats->mean /= stats->samples;
+		stats->p99 /= stats->samples;
+	}
+}
+
+static void print_edge_stats(const char *name, struct edge_stats *stats)
+{
+	if (stats->samples == 0) printf("  %-14s no statistics\n", name);
+	else if (stats->p99 < 0) printf("  %-14s mean %6.0f us, max %6ld us\n", name, stats->mean, stats->max);
+	else printf("  %-14s mean %6.0f us, p99 %6.0f us, max %6ld us\n", name, stats->mean, stats->p99, stats->max);
+}
+
+//timing error of the signals sent by cpulimit to groups of 1, 100 and 1000
+//busy processes, as reported in its verbose statistics: the delay from the
+//time at which a signal was planned to the time it was sent
+static void bench_edges(const char *limit)
+{
+	int sizes[] = { 1, 100, 1000 };
+	char *options[] = { "-v", NULL };
+	int i;
+	printf("Edge timing error, members limited to %s%%\n", limit);
+	for (i=0; i<3; i++) {
+		int output;
+		char name[32];
+		struct edge_stats stats;
+		pid_t family = spawn_family(sizes[i]);
+		pid_t limiter = start_limiter(family, limit, options, &output);
+		sleep_ms(8000);
+		stop_limiter(limiter);
+		kill_family(family);
+		read_edge_stats(output, EDGE_ERROR_COLUMN, &stats);
+		sprintf(name, "%d members:", sizes[i]);
+		print_edge_stats(name, &stats);
+	}
+}
+
+//timing error of the signals sent to a busy process, while the host is
+//saturated by other busy processes, with and without --realtime
+//the limit must be below the fair share of the process, or it never gets
+//signalled
+static void bench_realtime(const char *limit)
+{
+	char *normal[] = { "-v", NULL };
+	char *realtime[] = { "-v", "-R", NULL };
+	int i;
+	int ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	printf("Edge timing error, one process limited to %s%% on a host saturated by %d busy processes\n", limit, 2 * ncpu);
+	pid_t load = spawn_family(2 * ncpu);
+	for (i=0; i<2; i++) {
+		int output;
+		struct edge_stats stats;
+		pid_t family = spawn_family(1);
+		pid_t limiter = start_limiter(family, limit, i == 0 ? normal : realtime, &output);
+		sleep_ms(10000);
+		stop_limiter(limiter);
+		kill_family(family);
+		read_edge_stats(output, EDGE_ERROR_COLUMN, &stats);
+		print_edge_stats(i == 0 ? "normal" : "realtime", &stats);
+	}
+	kill_family(load);
+}
+
+//time from the first to the last SIGSTOP sent at the same time to a group
+//of busy processes, in the same process group or each in its own
+static void bench_fanout(int members, const char *limit)
+{
+	char *options[] = { "-v", NULL };
+	int i;
+	printf("Stop skew, %d members limited to %s%%\n", members, limit);
+	for (i=0; i<2; i++) {
+		int output;
+		struct edge_stats stats;
+		pid_t family = i == 0 ? spawn_scattered_family(members) : spawn_family(members);
+		pid_t limiter = start_limiter(family, limit, options, &output);
+		sleep_ms(8000);
+		stop_limiter(limiter);
+		kill_family(family);
+		read_edge_stats(output, STOP_SKEW_COLUMN, &stats);
+		print_edge_stats(i == 0 ? "own groups" : "one group", &stats);
+	}
+}
+
+//cpu time used by a process (in seconds), or -1 if it doesn't exist
+static double get_process_cputime(pid_t pid)
+{
+	char statfile[64], buffer[1024];
+	unsigned long utime, stime;
+	double cputime = -1;
+	sprintf(statfile, "/proc/%d/stat", pid);
+	FILE *fd = fopen(statfile, "r");
+	if (fd == NULL) return -1;
+	if (fgets(buffer, sizeof(buffer), fd) != NULL) {
+		char *p = strrchr(buffer, ')');
+		if (p != NULL && sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) == 2)
+			cputime = (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+	}
+	fclose(fd);
+	return cputime;
+}
+
+//first child of a process, or 0 if it has none yet
+static pid_t get_first_child(pid_t pid)
+{
+	char path[64];
+	int child = 0;
+	sprintf(path, "/proc/%d/task/%d/children", pid, pid);
+	FILE *fd = fopen(path, "r");
+	if (fd == NULL) return 0;
+	if (fscanf(fd, "%d", &child) != 1) child = 0;
+	fclose(fd);
+	return child;
+}
+
+//usage of a busy command run by cpulimit, over the first 100, 200, 500
+//and 1000 ms since cpulimit was started
+static void bench_startup(const char *limit)
+{
+	long windows[] = { 100, 200, 500, 1000 };
+	struct timespec start;
+	pid_t command = 0;
+	int i;
+	printf("Usage of a busy command run by cpulimit, limited to %s%%\n", limit);
+	fflush(stdout);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pid_t limiter = fork();
+	if (limiter == 0) {
+		freopen("/dev/null", "w", stdout);
+		execl(cpulimit_path, "cpulimit", "-l", limit, "sh", "-c", "while :; do :; done", NULL);
+		perror("execl");
+		exit(1);
+	}
+	while (command == 0 && elapsed_ms(&start) < windows[0]) command = get_first_child(limiter);
+	for (i=0; command > 0 && i<4; i++) {
+		long wait = windows[i] - elapsed_ms(&start);
+		if (wait > 0) sleep_ms(wait);
+		printf("  first %4ld ms: usage %6.2f%%\n", windows[i], get_process_cputime(command) * 1000 / windows[i] * 100);
+	}
+	if (command == 0) printf("  the command did not start\n");
+	stop_limiter(limiter);
+	if (command > 0) kill(command, SIGKILL);
+}
+
+static void print_usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s BENCHMARK [ARGS...]\n", name);
+	fprintf(stderr, "      runqueue [MEMBERS [LIMIT]]   host run-queue length with and without --stagger\n");
+	fprintf(stderr, "      warmup [LIMIT]               time to reach the limit after attaching\n");
+	fprintf(stderr, "      edges [LIMIT]                timing error of the signals for 1, 100 and 1000 members\n");
+	fprintf(stderr, "      realtime [LIMIT]             timing error of the signals on a saturated host, with and\n");
+	fprintf(stderr, "                                   without --realtime\n");
+	fprintf(stderr, "      fanout [MEMBERS [LIMIT]]     time from the first to the last member stopped\n");
+	fprintf(stderr, "      startup [LIMIT]              usage of a command run by cpulimit since it starts\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	//cpulimit is expected in ../src, relative to this program
+	char *p = strrchr(argv[0], '/');
+	if (p == NULL) sprintf(cpulimit_path, "../src/cpulimit");
+	else snprintf(cpulimit_path, sizeof(cpulimit_path), "%.*s/../src/cpulimit", (int)(p - argv[0]), argv[0]);
+	if (argc < 2) print_usage(argv[0]);
+	if (strcmp(argv[1], "runqueue") == 0) {
+		bench_runqueue(argc > 2 ? atoi(argv[2]) : 8, argc > 3 ? argv[3] : "50");
+	}
+	else if (strcmp(argv[1], "warmup") == 0) {
+		bench_warmup(argc > 2 ? argv[2] : "30");
+	}
+	else if (strcmp(argv[1], "edges") == 0) {
+		bench_edges(argc > 2 ? argv[2] : "50");
+	}
+	else if (strcmp(argv[1], "realtime") == 0) {
+		bench_realtime(argc > 2 ? argv[2] : "10");
+	}
+	else if (strcmp(argv[1], "fanout") == 0) {
+		bench_fanout(argc > 2 ? atoi(argv[2]) : 100, argc > 3 ? argv[3] : "50");
+	}
+	else if (strcmp(argv[1], "startup") == 0) {
+		bench_startup(argc > 2 ? argv[2] : "20");
+	}
+	else {
+		print_usage(argv[0]);
+	}
+	return 0;
+}
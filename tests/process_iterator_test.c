@@ -58,6 +58,7 @@ void test_single_process()
 	{
 		assert(process.pid == getpid());
 		assert(process.ppid == getppid());
+		assert(process.pgid == getpgrp());
 		assert(process.cputime < 100);
 //		assert(process.starttime == now || process.starttime == now - 1);
 		count++;
@@ -191,6 +192,17 @@ void test_process_group_single(int include_children)
 	kill(child, SIGINT);
 }
 
+void test_process_io()
+{
+	//the counters of a process never go back, and a missing process has none
+	long long bytes = get_process_io(getpid());
+#ifdef __linux__
+	assert(bytes >= 0);
+#endif
+	assert(get_process_io(getpid()) >= bytes);
+	assert(get_process_io(9999999) == -1);
+}
+
 void test_process_name(const char * command)
 {
 	struct process_iterator it;
@@ -237,6 +249,7 @@ int main(int argc, char **argv)
 	test_process_group_single(0);
 	test_process_group_single(1);
 	test_process_group_wrong_pid();
+	test_process_io();
 	test_process_name(argv[0]);
 	return 0;
 }
@@ -0,0 +1,77 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include <schedule.h>
+
+//local time of today at hh:mm
+static time_t today_at(int hh, int mm)
+{
+	time_t now = time(NULL);
+	struct tm tm;
+	localtime_r(&now, &tm);
+	tm.tm_hour = hh;
+	tm.tm_min = mm;
+	tm.tm_sec = 0;
+	tm.tm_isdst = -1;
+	return mktime(&tm);
+}
+
+void test_parse_entries()
+{
+	struct schedule_entry e;
+	assert(parse_schedule_entry("08:00-18:30=100", &e) == 0);
+	assert(e.start == 8 * 60 && e.end == 18 * 60 + 30 && e.limit == 1);
+	assert(parse_schedule_entry("18:00-24:00=800", &e) == 0);
+	assert(e.start == 18 * 60 && e.end == 0 && e.limit == 8);
+	assert(parse_schedule_entry("08:00-18:00", &e) != 0);
+	assert(parse_schedule_entry("08:00-18:00=50%", &e) != 0);
+	assert(parse_schedule_entry("08:60-18:00=50", &e) != 0);
+	assert(parse_schedule_entry("8-18=50", &e) != 0);
+}
+
+void test_lookup()
+{
+	struct schedule_entry entries[2];
+	assert(parse_schedule_entry("08:00-18:00=100", &entries[0]) == 0);
+	assert(parse_schedule_entry("22:00-06:00=800", &entries[1]) == 0);
+	assert(get_scheduled_limit(entries, 2, today_at(8, 0)) == 1);
+	assert(get_scheduled_limit(entries, 2, today_at(17, 59)) == 1);
+	assert(get_scheduled_limit(entries, 2, today_at(18, 0)) == -1);
+	//ranges wrapping around midnight
+	assert(get_scheduled_limit(entries, 2, today_at(23, 30)) == 8);
+	assert(get_scheduled_limit(entries, 2, today_at(0, 0)) == 8);
+	assert(get_scheduled_limit(entries, 2, today_at(5, 59)) == 8);
+	assert(get_scheduled_limit(entries, 2, today_at(6, 0)) == -1);
+	assert(get_scheduled_limit(entries, 0, today_at(12, 0)) == -1);
+}
+
+int main(int argc, char **argv)
+{
+	test_parse_entries();
+	test_lookup();
+	return 0;
+}
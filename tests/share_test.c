@@ -0,0 +1,137 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <process_group.h>
+#include <share.h>
+
+//build a fake group: target 100 with children 101 and 102, and 103 child of 101
+static void init_fake_group(struct process_group *pgroup, struct process *procs)
+{
+	int i;
+	memset(pgroup, 0, sizeof(struct process_group));
+	pgroup->target_pid = 100;
+	pgroup->proclist = (struct list*)malloc(sizeof(struct list));
+	init_list(pgroup->proclist, 4);
+	pid_t ppids[] = { 1, 100, 100, 101 };
+	for (i=0; i<4; i++) {
+		memset(&procs[i], 0, sizeof(struct process));
+		procs[i].pid = 100 + i;
+		procs[i].ppid = ppids[i];
+		sprintf(procs[i].command, "/usr/bin/%s", i == 0 ? "server" : "helper");
+		procs[i].cpu_usage = 1;
+		procs[i].workingrate = 1;
+		procs[i].share = 1;
+		int hashkey = pid_hashfn(procs[i].pid);
+		pgroup->proctable[hashkey] = (struct list*)malloc(sizeof(struct list));
+		init_list(pgroup->proctable[hashkey], 4);
+		add_elem(pgroup->proctable[hashkey], &procs[i]);
+		add_elem(pgroup->proclist, &procs[i]);
+	}
+}
+
+static void close_fake_group(struct process_group *pgroup)
+{
+	int i;
+	for (i=0; i<PIDHASH_SZ; i++) {
+		if (pgroup->proctable[i] == NULL) continue;
+		clear_list(pgroup->proctable[i]);
+		free(pgroup->proctable[i]);
+	}
+	clear_list(pgroup->proclist);
+	free(pgroup->proclist);
+}
+
+#define EQUAL(a,b) ((a)-(b) < 0.001 && (b)-(a) < 0.001)
+
+void test_parse_rules()
+{
+	struct share_rule rule;
+	assert(parse_share_rule("pid=1234:50", &rule) == 0);
+	assert(rule.type == SHARE_BY_PID && rule.value == 1234 && rule.weight == 50);
+	assert(parse_share_rule("name=my:server:20.5", &rule) == 0);
+	assert(rule.type == SHARE_BY_NAME && strcmp(rule.name, "my:server") == 0 && rule.weight == 20.5);
+	assert(parse_share_rule("depth=0:70", &rule) == 0);
+	assert(rule.type == SHARE_BY_DEPTH && rule.value == 0 && rule.weight == 70);
+	assert(parse_share_rule("depth=0", &rule) != 0);
+	assert(parse_share_rule("depth=x:10", &rule) != 0);
+	assert(parse_share_rule("pid=1:101", &rule) != 0);
+	assert(parse_share_rule("uid=0:10", &rule) != 0);
+	assert(parse_share_rule("name=:10", &rule) != 0);
+}
+
+void test_depth()
+{
+	struct process_group pgroup;
+	struct process procs[4];
+	init_fake_group(&pgroup, procs);
+	assert(get_process_depth(&pgroup, &procs[0]) == 0);
+	assert(get_process_depth(&pgroup, &procs[1]) == 1);
+	assert(get_process_depth(&pgroup, &procs[3]) == 2);
+	close_fake_group(&pgroup);
+}
+
+void test_weighted_shares()
+{
+	struct process_group pgroup;
+	struct process procs[4];
+	struct share_rule rules[1];
+	init_fake_group(&pgroup, procs);
+	//all the members demand a full cpu, the parent gets 70% of 1 cpu
+	assert(parse_share_rule("depth=0:70", &rules[0]) == 0);
+	update_shares(&pgroup, rules, 1, 1.0);
+	assert(EQUAL(procs[0].share, 1));
+	assert(EQUAL(procs[1].share, 0.1 / 0.7));
+	assert(EQUAL(procs[2].share, 0.1 / 0.7));
+	assert(EQUAL(procs[3].share, 0.1 / 0.7));
+	close_fake_group(&pgroup);
+}
+
+void test_work_conserving_shares()
+{
+	struct process_group pgroup;
+	struct process procs[4];
+	struct share_rule rules[1];
+	init_fake_group(&pgroup, procs);
+	//the parent only needs 20% of a cpu, the helpers get the rest
+	procs[0].cpu_usage = 0.2;
+	assert(parse_share_rule("name=server:70", &rules[0]) == 0);
+	update_shares(&pgroup, rules, 1, 1.0);
+	assert(EQUAL(procs[0].share, 1));
+	assert(EQUAL(procs[1].share, procs[2].share));
+	assert(EQUAL(procs[1].share, procs[3].share));
+	//the helpers share the remaining 80% of the cpu
+	assert(EQUAL(procs[1].share, 0.8 / 3));
+	close_fake_group(&pgroup);
+}
+
+int main(int argc, char **argv)
+{
+	test_parse_rules();
+	test_depth();
+	test_weighted_shares();
+	test_work_conserving_shares();
+	return 0;
+}
@@ -0,0 +1,199 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <assert.h>
+
+#include <slot.h>
+
+//nominal slot length, as in cpulimit (in microseconds)
+#define TIME_SLOT 100000
+//simulation step (in microseconds)
+#define STEP 1000
+//simulated time for each phase of the workload (in microseconds)
+#define DURATION 60000000L
+
+void test_work_windows()
+{
+	struct slot_plan plan;
+	struct process p1, p2, p3;
+	init_slot_plan(&plan, TIME_SLOT);
+	//a window wrapping around the end of the slot
+	add_work_window(&plan, &p1, 80000, 30000);
+	//a member never stopped, and one never resumed
+	add_work_window(&plan, &p2, 0, TIME_SLOT);
+	add_work_window(&plan, &p3, 0, 0);
+	sort_slot_plan(&plan);
+	assert(plan.count == 4);
+	assert(plan.edges[0].offset == 0 && plan.edges[0].sig == SIGSTOP && plan.edges[0].proc == &p3);
+	assert(plan.edges[1].offset == 0 && plan.edges[1].sig == SIGCONT && plan.edges[1].proc == &p2);
+	assert(plan.edges[2].offset == 10000 && plan.edges[2].sig == SIGSTOP && plan.edges[2].proc == &p1);
+	assert(plan.edges[3].offset == 80000 && plan.edges[3].sig == SIGCONT && plan.edges[3].proc == &p1);
+	close_slot_plan(&plan);
+}
+
+void test_batch()
+{
+	struct slot_plan plan;
+	struct process members[5];
+	int i;
+	init_slot_plan(&plan, TIME_SLOT);
+	//members 0-2 are a whole process group, 3 shares its process group
+	//with a process out of the limited group, 4 is alone
+	for (i=0; i<5; i++) {
+		members[i].pid = 100 + i;
+		members[i].pgid = i < 3 ? 100 : 103 + (i == 4);
+		members[i].pgid_members = i < 3 ? 3 : 0;
+	}
+	for (i=4; i>=0; i--) add_work_window(&plan, &members[i], 0, 30000);
+	sort_slot_plan(&plan);
+	assert(batch_slot_plan(&plan) == 4);
+	assert(plan.count == 6);
+	assert(plan.edges[0].offset == 0 && plan.edges[0].sig == SIGCONT && plan.edges[0].pgid == 100);
+	assert(plan.edges[1].pgid == 0 && plan.edges[1].proc == &members[3]);
+	assert(plan.edges[2].pgid == 0 && plan.edges[2].proc == &members[4]);
+	assert(plan.edges[3].offset == 30000 && plan.edges[3].sig == SIGSTOP && plan.edges[3].pgid == 100);
+	close_slot_plan(&plan);
+	//the process group is not batched if one of its members has its own window
+	init_slot_plan(&plan, TIME_SLOT);
+	for (i=0; i<3; i++) add_work_window(&plan, &members[i], 0, i == 2 ? 50000 : 30000);
+	sort_slot_plan(&plan);
+	assert(batch_slot_plan(&plan) == 2);
+	assert(plan.count == 4);
+	assert(plan.edges[0].sig == SIGCONT && plan.edges[0].pgid == 100);
+	assert(plan.edges[1].sig == SIGSTOP && plan.edges[1].pgid == 0 && plan.edges[1].offset == 30000);
+	assert(plan.edges[2].sig == SIGSTOP && plan.edges[2].pgid == 0 && plan.edges[2].offset == 30000);
+	assert(plan.edges[3].sig == SIGSTOP && plan.edges[3].proc == &members[2]);
+	close_slot_plan(&plan);
+}
+
+void test_dither_range()
+{
+	unsigned int seed = 1;
+	long slot;
+	double position;
+	int i;
+	double total = 0;
+	assert(dither_slot(TIME_SLOT, 0, &seed, &position) == TIME_SLOT && position == 0);
+	for (i=0; i<10000; i++) {
+		slot = dither_slot(TIME_SLOT, 0.5, &seed, &position);
+		assert(slot >= TIME_SLOT / 2 && slot <= TIME_SLOT * 3 / 2);
+		assert(position >= 0 && position <= 1);
+		total += slot;
+	}
+	//the slots are as long as the nominal one on average
+	assert(total / i > TIME_SLOT * 0.99 && total / i < TIME_SLOT * 1.01);
+}
+
+//1 if the member is running at the given offset of the slot, as planned
+//the signal sent last in the slot is still in effect at its beginning
+static int is_planned_active(const struct slot_plan *plan, long offset)
+{
+	int i;
+	int sig = plan->count > 0 ? plan->edges[plan->count - 1].sig : SIGSTOP;
+	for (i=0; i<plan->count && plan->edges[i].offset <= offset; i++) sig = plan->edges[i].sig;
+	return sig == SIGCONT;
+}
+
+//simulate a workload that wakes up every period to do some work, and drops
+//the frame if it's not done within the deadline, limited with the given
+//working rate
+//return the fraction of the frames completed, and in duty the fraction of
+//time in which the workload was allowed to run
+static double simulate_periodic(long period, long offset, long work, long deadline, double workingrate, double dither, double *duty)
+{
+	unsigned int seed = 1;
+	struct slot_plan plan;
+	struct process proc;
+	long t, slot_start = 0, slot = 0;
+	double position;
+	long frames = 0, completed = 0, active_time = 0;
+	long pending = 0, frame_end = 0;
+	init_slot_plan(&plan, TIME_SLOT);
+	for (t=0; t<DURATION; t+=STEP) {
+		if (t >= slot_start + slot) {
+			slot_start += slot;
+			slot = dither_slot(TIME_SLOT, dither, &seed, &position);
+			//the working slice, placed as cpulimit does
+			long twork = slot * workingrate;
+			clear_slot_plan(&plan, slot);
+			add_work_window(&plan, &proc, (long)(position * (slot - twork)), twork);
+			sort_slot_plan(&plan);
+			//the dithered window never wraps around the end of the slot
+			assert(plan.count == 2);
+			assert(plan.edges[0].sig == SIGCONT && plan.edges[1].sig == SIGSTOP);
+			assert(plan.edges[1].offset - plan.edges[0].offset == twork);
+		}
+		if (t % period == offset) {
+			frames++;
+			pending = work;
+			frame_end = t + deadline;
+		}
+		if (pending > 0 && t >= frame_end) pending = 0;
+		if (is_planned_active(&plan, t - slot_start)) {
+			active_time += STEP;
+			if (pending > 0) {
+				pending -= STEP;
+				if (pending <= 0) completed++;
+			}
+		}
+	}
+	close_slot_plan(&plan);
+	*duty = (double)active_time / DURATION;
+	return (double)completed / frames;
+}
+
+//a workload with the same period as the slot, phase-locked with it
+void test_aliasing(double dither)
+{
+	long offset;
+	double duty, min = 1, max = 0;
+	printf("Periodic workload (100 ms period, 10 ms of work due in 20 ms), 30%% duty, dither %0.2f\n", dither);
+	for (offset=0; offset<100000; offset+=10000) {
+		double completed = simulate_periodic(100000, offset, 10000, 20000, 0.3, dither, &duty);
+		printf("  phase %3ld ms: %5.1f%% of the frames completed, duty %0.3f\n", offset / 1000, completed * 100, duty);
+		if (completed < min) min = completed;
+		if (completed > max) max = completed;
+		//the duty cycle is kept exactly on average
+		assert(duty > 0.29 && duty < 0.31);
+	}
+	if (dither == 0) {
+		//with fixed slots the outcome depends only on the phase of the workload
+		assert(max - min > 0.9);
+	}
+	else {
+		//with dithered slots every phase gets about the same service
+		assert(max - min < 0.1);
+		assert(min > 0.2);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	test_work_windows();
+	test_batch();
+	test_dither_range();
+	test_aliasing(0);
+	test_aliasing(0.5);
+	return 0;
+}
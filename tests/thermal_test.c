@@ -0,0 +1,79 @@
+/**
+ *
+ * cpulimit - a CPU limiter for Linux
+ *
+ * Copyright (C) 2005-2012, by:  Angelo Marletta <angelo dot marletta at gmail dot com> 
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include <thermal.h>
+
+//write a temperature in millidegrees, as the kernel does
+static void write_temperature(const char *path, long millidegrees)
+{
+	FILE *fd = fopen(path, "w");
+	assert(fd != NULL);
+	fprintf(fd, "%ld\n", millidegrees);
+	fclose(fd);
+}
+
+void test_zone_file()
+{
+	char path[] = "/tmp/thermal_test_XXXXXX";
+	struct thermal_zone z;
+	int i;
+	close(mkstemp(path));
+	assert(init_thermal_zone(&z, path) != 0);
+	write_temperature(path, 45000);
+	assert(init_thermal_zone(&z, path) == 0);
+	assert(z.temperature == 45);
+	//the new value is read from the same descriptor, and it is smoothed
+	write_temperature(path, 85500);
+	assert(update_thermal_zone(&z) == 0);
+	assert(z.temperature > 45 && z.temperature < 85.5);
+	for (i=0; i<50; i++) assert(update_thermal_zone(&z) == 0);
+	assert(z.temperature > 85.4 && z.temperature <= 85.5);
+	close_thermal_zone(&z);
+	assert(init_thermal_zone(&z, "/nonexistent/temp") != 0);
+	unlink(path);
+}
+
+void test_factor()
+{
+	assert(get_thermal_factor(40, 80) == 1);
+	assert(get_thermal_factor(80 - THERMAL_BAND, 80) == 1);
+	assert(get_thermal_factor(80 - THERMAL_BAND / 2.0, 80) == 0.5);
+	assert(get_thermal_factor(80, 80) == THERMAL_MIN_FACTOR);
+	assert(get_thermal_factor(95, 80) == THERMAL_MIN_FACTOR);
+	//it never increases with the temperature
+	double t, last = 1;
+	for (t=60; t<90; t+=0.5) {
+		assert(get_thermal_factor(t, 80) <= last);
+		last = get_thermal_factor(t, 80);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	test_zone_file();
+	test_factor();
+	return 0;
+}